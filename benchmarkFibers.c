@@ -0,0 +1,131 @@
+/*
+ * Mede o custo do escalonador com muitas fibers:
+ *  - walk:   a política "edf" sem prazos percorre toda a fila de prontos a cada
+ *            inserção, lendo só o cabeçalho das fibers; cada fiber cede a CPU uma
+ *            vez e o tempo é dado por fiber visitada. Como uma rodada com n fibers
+ *            visita n * (n - 1) cabeçalhos, esta fase usa só WALK_FIBERS fibers;
+ *  - switch: a política "fifo" com todas as fibers cedendo a CPU; o tempo é dado
+ *            por troca de contexto completa (enqueue, pick_next e swapcontext).
+ *
+ * Antes da separação entre cabeçalho e Fiber_Cold, cada fiber era uma única
+ * struct alocada com malloc contendo todos os campos, inclusive o contexto salvo,
+ * e percorrer a fila tocava as linhas de cache dessa struct inteira. Para
+ * comparar, compile este programa contra uma versão da biblioteca com esse layout.
+ *
+ *   gcc -O2 benchmarkFibers.c fiber.c -o benchmark && ./benchmark [fibers]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "fiber.h"
+
+// Quantas vezes cada fiber cede a CPU
+#define ROUNDS 10
+
+// Fibers na fase walk, menos que as da fase switch; cada inserção visita todas
+#define WALK_FIBERS 10000
+
+void *rotina(void *arg)
+{
+    for (int i = 0; i < ROUNDS; i++)
+        fiber_yield();
+
+    return NULL;
+}
+
+void *cede(void *arg)
+{
+    fiber_yield();
+
+    return NULL;
+}
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Contador de cache misses do processo; -1 caso o kernel não permita
+int open_cache_misses()
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+long long read_counter(int fd)
+{
+    long long value = 0;
+    if (fd == -1 || read(fd, &value, sizeof(value)) != sizeof(value))
+        return -1;
+    return value;
+}
+
+// Cria n fibers no grupo, espera todas terminarem e imprime o custo por unidade
+int run(const char *label, const char *policy, int n, void *(*routine)(void *), double units, const char *unit, int misses)
+{
+    if (fiber_sched_set_policy(policy) == -1)
+    {
+        perror("cannot set the policy\n");
+        return -1;
+    }
+
+    fiber_group_t group;
+    fiber_group_create(&group);
+
+    for (int i = 0; i < n; i++)
+    {
+        if (fiber_group_spawn(group, NULL, routine, NULL) == -1)
+        {
+            perror("cannot create a fiber\n");
+            return -1;
+        }
+    }
+
+    long long m0 = read_counter(misses);
+    double t0 = now();
+    fiber_group_join_all(group);
+    double t1 = now();
+    long long m1 = read_counter(misses);
+
+    printf("%s %.2f ns/%s", label, (t1 - t0) / units, unit);
+    if (misses != -1)
+        printf(", %.3f cache misses/%s", (double)(m1 - m0) / units, unit);
+    printf("\n");
+
+    fiber_group_destroy(group);
+
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    int misses = open_cache_misses();
+
+    printf("fibers: %d (walk: %d, reduced because each edf insert walks the whole queue)\n", n, WALK_FIBERS);
+
+    // Cada yield reinsere a fiber no fim da fila, visitando as outras WALK_FIBERS - 1
+    double visits = (double)WALK_FIBERS * (WALK_FIBERS - 1);
+    if (run("walk:  ", "edf", WALK_FIBERS, cede, visits, "fiber", misses) == -1)
+        return -1;
+
+    // Sem preempção, para medir só as trocas feitas pela fiber_yield
+    double switches = (double)n * (ROUNDS + 1);
+    if (run("switch:", "fifo", n, rotina, switches, "switch", misses) == -1)
+        return -1;
+
+    return 0;
+}
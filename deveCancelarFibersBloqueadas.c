@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include "fiber.h"
+
+int limpezas = 0;
+
+void limpeza(void *arg)
+{
+    limpezas++;
+}
+
+void *dorminhoca(void *arg)
+{
+    fiber_cleanup_push(limpeza, NULL);
+    fiber_sleep(10 * 1000 * 1000);
+    fiber_cleanup_pop(0);
+
+    return NULL;
+}
+
+void *estacionada(void *arg)
+{
+    fiber_park();
+
+    return NULL;
+}
+
+void *esperando(void *arg)
+{
+    fiber_cleanup_push(limpeza, NULL);
+    fiber_join(arg, NULL);
+    fiber_cleanup_pop(0);
+
+    return NULL;
+}
+
+int main(int argc, char const *argv[])
+{
+    fiber_t dorme, alvo, espera;
+    void *retval = NULL;
+
+    // Cancela uma fiber bloqueada na fiber_sleep
+    if (fiber_create(&dorme, dorminhoca, NULL) == -1)
+        perror("cannot create a fiber\n");
+    fiber_yield();
+    fiber_cancel(dorme);
+
+    if (fiber_join(dorme, &retval) != 0 || retval != FIBER_CANCELED || limpezas != 1)
+    {
+        printf("falhou: a fiber na fiber_sleep não foi cancelada\n");
+        return -1;
+    }
+
+    // Cancela uma fiber bloqueada na fiber_join de outra
+    if (fiber_create(&alvo, estacionada, NULL) == -1 || fiber_create(&espera, esperando, alvo) == -1)
+        perror("cannot create a fiber\n");
+    fiber_yield();
+    fiber_cancel(espera);
+
+    retval = NULL;
+    if (fiber_join(espera, &retval) != 0 || retval != FIBER_CANCELED || limpezas != 2)
+    {
+        printf("falhou: a fiber na fiber_join não foi cancelada\n");
+        return -1;
+    }
+
+    // A fiber esperada continua viva e termina normalmente
+    fiber_unpark(alvo);
+    if (fiber_join(alvo, &retval) != 0 || retval != NULL)
+    {
+        printf("falhou: a fiber esperada não terminou\n");
+        return -1;
+    }
+
+    printf("ok\n");
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include "fiber.h"
+
+#define FILHAS 4
+
+void *rapida(void *arg)
+{
+    return arg;
+}
+
+void *lenta(void *arg)
+{
+    fiber_sleep(10 * 1000 * 1000);
+
+    return arg;
+}
+
+int main(int argc, char const *argv[])
+{
+    fiber_group_t group;
+    fiber_t vencedora, fiber;
+    void *retval;
+
+    fiber_group_create(&group);
+
+    for (long i = 1; i < FILHAS; i++)
+        fiber_group_spawn(group, NULL, lenta, (void *)i);
+    fiber_group_spawn(group, &vencedora, rapida, (void *)0);
+
+    // A primeira a terminar vence e as outras são canceladas
+    if (fiber_group_wait_any(group, &fiber, &retval, 1) != 0 || fiber != vencedora || retval != (void *)0)
+    {
+        printf("falhou: a wait_any não retornou a fiber mais rápida\n");
+        return -1;
+    }
+
+    int perdedoras = 0;
+    while (fiber_group_wait_any(group, &fiber, &retval, 0) == 0)
+    {
+        if (retval != FIBER_CANCELED)
+        {
+            printf("falhou: uma perdedora terminou sem ser cancelada\n");
+            return -1;
+        }
+        perdedoras++;
+    }
+
+    if (perdedoras != FILHAS - 1)
+    {
+        printf("falhou: %d perdedoras canceladas de %d\n", perdedoras, FILHAS - 1);
+        return -1;
+    }
+
+    fiber_group_destroy(group);
+
+    printf("ok\n");
+
+    return 0;
+}
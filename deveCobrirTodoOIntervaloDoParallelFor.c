@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include "fiber.h"
+
+#define INICIO 3
+#define FIM 10007
+
+int visitas[FIM];
+
+void marca(long begin, long end, void *arg)
+{
+    for (long i = begin; i < end; i++)
+        visitas[i]++;
+
+    fiber_yield();
+}
+
+int verifica(long grain)
+{
+    for (long i = 0; i < FIM; i++)
+        visitas[i] = 0;
+
+    if (fiber_parallel_for(INICIO, FIM, grain, marca, NULL) != 0)
+    {
+        printf("falhou: fiber_parallel_for com grain %ld\n", grain);
+        return -1;
+    }
+
+    // Cada índice de [INICIO, FIM) exatamente uma vez, e nenhum fora dele
+    for (long i = 0; i < FIM; i++)
+    {
+        if (visitas[i] != (i >= INICIO))
+        {
+            printf("falhou: índice %ld visitado %d vezes com grain %ld\n", i, visitas[i], grain);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    long grains[] = {1, 7, 100, FIM, 0};
+
+    for (int i = 0; i < 5; i++)
+        if (verifica(grains[i]) == -1)
+            return -1;
+
+    printf("ok\n");
+
+    return 0;
+}
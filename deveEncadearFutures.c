@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include "fiber.h"
+
+void *dez(void *arg)
+{
+    return (void *)10L;
+}
+
+void *dobro(void *arg)
+{
+    return (void *)((long)arg * 2);
+}
+
+void *mais_um(void *arg)
+{
+    return (void *)((long)arg + 1);
+}
+
+int main(int argc, char const *argv[])
+{
+    fiber_future_t primeira, segunda, terceira;
+    void *value = NULL;
+
+    // (10 * 2) + 1
+    if (fiber_async(&primeira, dez, NULL) == -1 || future_then(primeira, &segunda, dobro) == -1 ||
+        future_then(segunda, &terceira, mais_um) == -1)
+    {
+        printf("falhou: não criou as futures\n");
+        return -1;
+    }
+
+    if (future_get(terceira, &value) != 0 || (long)value != 21)
+    {
+        printf("falhou: a cadeia retornou %ld em vez de 21\n", (long)value);
+        return -1;
+    }
+
+    // Uma continuação registrada depois da future pronta também executa
+    fiber_future_t tardia;
+    if (future_then(primeira, &tardia, mais_um) == -1 || future_get(tardia, &value) != 0 || (long)value != 11)
+    {
+        printf("falhou: a continuação tardia retornou %ld em vez de 11\n", (long)value);
+        return -1;
+    }
+
+    future_destroy(primeira);
+    future_destroy(segunda);
+    future_destroy(terceira);
+    future_destroy(tardia);
+
+    printf("ok\n");
+
+    return 0;
+}
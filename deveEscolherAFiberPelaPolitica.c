@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <time.h>
+#include "fiber.h"
+
+#define FIBERS 4
+
+int ordem[FIBERS];
+int executadas = 0;
+
+void *estaciona(void *arg)
+{
+    // Ao ser acordada volta para a fila com a prioridade ou o prazo já definidos
+    fiber_park();
+    ordem[executadas++] = (long)arg;
+
+    return NULL;
+}
+
+void *registra(void *arg)
+{
+    ordem[executadas++] = (long)arg;
+
+    return NULL;
+}
+
+// Política do usuário: a última fiber pronta é a primeira a executar
+fiber_t pilha[FIBERS + 1];
+int topo = 0;
+
+void lifo_enqueue(fiber_t fiber)
+{
+    pilha[topo++] = fiber;
+}
+
+fiber_t lifo_pick_next()
+{
+    return topo > 0 ? pilha[--topo] : NULL;
+}
+
+const fiber_sched_policy_t lifo = {"lifo", lifo_enqueue, lifo_pick_next, NULL, NULL, NULL};
+
+// Cria as fibers, aplica os atributos e as acorda todas de uma vez
+int executa(const char *politica, int esperada[FIBERS], int prioridades[FIBERS], unsigned long long prazos[FIBERS])
+{
+    fiber_t fibers[FIBERS];
+
+    if (fiber_sched_set_policy(politica) == -1)
+    {
+        printf("falhou: não trocou para a política %s\n", politica);
+        return -1;
+    }
+
+    executadas = 0;
+    for (long i = 0; i < FIBERS; i++)
+    {
+        fiber_create(&fibers[i], estaciona, (void *)i);
+        fiber_set_priority(fibers[i], prioridades[i]);
+        fiber_set_deadline(fibers[i], prazos[i]);
+    }
+
+    // Todas param na fiber_park antes de serem acordadas
+    fiber_yield();
+    for (int i = 0; i < FIBERS; i++)
+        fiber_unpark(fibers[i]);
+    for (int i = 0; i < FIBERS; i++)
+        fiber_join(fibers[i], NULL);
+
+    for (int i = 0; i < FIBERS; i++)
+    {
+        if (ordem[i] != esperada[i])
+        {
+            printf("falhou: a política %s executou a fiber %d na posição %d\n", politica, ordem[i], i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    unsigned long long agora = 1000000000ULL * time(NULL);
+    int prioridades[FIBERS] = {3, 20, 0, 10};
+    unsigned long long prazos[FIBERS] = {agora + 300, 0, agora + 100, agora + 200};
+    int nenhuma[FIBERS] = {0, 0, 0, 0};
+    unsigned long long sem_prazo[FIBERS] = {0, 0, 0, 0};
+
+    // Maior prioridade primeiro
+    int por_prioridade[FIBERS] = {1, 3, 0, 2};
+    if (executa("priority", por_prioridade, prioridades, sem_prazo) == -1)
+        return -1;
+
+    // Prazo mais cedo primeiro; sem prazo por último
+    int por_prazo[FIBERS] = {2, 3, 0, 1};
+    if (executa("edf", por_prazo, nenhuma, prazos) == -1)
+        return -1;
+
+    // Política registrada pelo usuário
+    if (fiber_sched_register(&lifo) != 0 || fiber_sched_register(&lifo) != -1)
+    {
+        printf("falhou: fiber_sched_register\n");
+        return -1;
+    }
+    if (fiber_sched_set_policy("inexistente") != -1)
+    {
+        printf("falhou: trocou para uma política inexistente\n");
+        return -1;
+    }
+    if (fiber_sched_set_policy("lifo") != 0 || fiber_sched_policy_name() == NULL)
+    {
+        printf("falhou: não trocou para a política lifo\n");
+        return -1;
+    }
+
+    fiber_t fibers[FIBERS];
+    executadas = 0;
+    for (long i = 0; i < FIBERS; i++)
+        fiber_create(&fibers[i], registra, (void *)i);
+    for (int i = 0; i < FIBERS; i++)
+        fiber_join(fibers[i], NULL);
+
+    for (int i = 0; i < FIBERS; i++)
+    {
+        if (ordem[i] != FIBERS - 1 - i)
+        {
+            printf("falhou: a política lifo executou a fiber %d na posição %d\n", ordem[i], i);
+            return -1;
+        }
+    }
+
+    printf("ok\n");
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "fiber.h"
+
+int pipefd[2];
+int sockets[2];
+
+void *leitora(void *arg)
+{
+    char c;
+
+    if (fiber_wait_io(pipefd[0], EPOLLIN) == -1 || read(pipefd[0], &c, 1) != 1)
+        return NULL;
+
+    return (void *)1;
+}
+
+void *le_socket(void *arg)
+{
+    char c;
+
+    if (fiber_wait_io(sockets[0], EPOLLIN) == -1 || read(sockets[0], &c, 1) != 1)
+        return NULL;
+
+    return (void *)1;
+}
+
+void *escreve_socket(void *arg)
+{
+    if (fiber_wait_io(sockets[0], EPOLLOUT) == -1 || write(sockets[0], "y", 1) != 1)
+        return NULL;
+
+    return (void *)1;
+}
+
+int main(int argc, char const *argv[])
+{
+    fiber_t primeira, segunda, le, escreve;
+    void *retval1 = NULL, *retval2 = NULL;
+    char c;
+
+    if (pipe(pipefd) == -1 || socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == -1)
+    {
+        perror("pipe");
+        return -1;
+    }
+
+    // Duas leitoras no mesmo pipe; cada byte acorda as duas, e cada uma lê um
+    if (fiber_create(&primeira, leitora, NULL) == -1 || fiber_create(&segunda, leitora, NULL) == -1)
+        perror("cannot create a fiber\n");
+    fiber_yield();
+
+    if (write(pipefd[1], "xx", 2) != 2)
+        perror("write");
+
+    fiber_join(primeira, &retval1);
+    fiber_join(segunda, &retval2);
+    if (retval1 != (void *)1 || retval2 != (void *)1)
+    {
+        printf("falhou: as duas leitoras do pipe não leram\n");
+        return -1;
+    }
+
+    // Uma leitora e uma escritora no mesmo socket
+    if (fiber_create(&le, le_socket, NULL) == -1 || fiber_create(&escreve, escreve_socket, NULL) == -1)
+        perror("cannot create a fiber\n");
+
+    fiber_join(escreve, &retval2);
+    if (retval2 != (void *)1 || read(sockets[1], &c, 1) != 1 || c != 'y')
+    {
+        printf("falhou: a escritora do socket não escreveu\n");
+        return -1;
+    }
+
+    if (write(sockets[1], "z", 1) != 1)
+        perror("write");
+
+    fiber_join(le, &retval1);
+    if (retval1 != (void *)1)
+    {
+        printf("falhou: a leitora do socket não leu\n");
+        return -1;
+    }
+
+    printf("ok\n");
+
+    return 0;
+}
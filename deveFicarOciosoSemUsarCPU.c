@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "fiber.h"
+
+// Tempo que cada fiber passa bloqueada, em microsegundos
+#define ESPERA 300000
+
+int pipefd[2];
+
+void *dorminhoca(void *arg)
+{
+    fiber_sleep(ESPERA);
+
+    return NULL;
+}
+
+void *escritora(void *arg)
+{
+    fiber_sleep(ESPERA);
+
+    if (write(pipefd[1], "x", 1) != 1)
+        perror("write");
+
+    return NULL;
+}
+
+void *leitora(void *arg)
+{
+    char c;
+
+    if (fiber_wait_io(pipefd[0], EPOLLIN) == -1 || read(pipefd[0], &c, 1) != 1)
+        return NULL;
+
+    return (void *)1;
+}
+
+int main(int argc, char const *argv[])
+{
+    fiber_t dorme, escreve, le;
+    void *retval = NULL;
+
+    if (pipe(pipefd) == -1)
+    {
+        perror("pipe");
+        return -1;
+    }
+
+    if (fiber_create(&dorme, dorminhoca, NULL) == -1 || fiber_create(&escreve, escritora, NULL) == -1 ||
+        fiber_create(&le, leitora, NULL) == -1)
+        perror("cannot create a fiber\n");
+
+    // Todas as fibers ficam bloqueadas; o processo deve dormir em vez de girar
+    clock_t inicio = clock();
+    fiber_join(dorme, NULL);
+    fiber_join(escreve, NULL);
+    fiber_join(le, &retval);
+    double cpu = (double)(clock() - inicio) / CLOCKS_PER_SEC;
+
+    if (retval != (void *)1)
+    {
+        printf("falhou: a leitora não recebeu o dado\n");
+        return -1;
+    }
+
+    // Menos de 5% do tempo bloqueado
+    if (cpu > ESPERA / 1e6 * 0.05)
+    {
+        printf("falhou: %.3f s de CPU enquanto ocioso\n", cpu);
+        return -1;
+    }
+
+    printf("ok: %.3f s de CPU\n", cpu);
+
+    return 0;
+}
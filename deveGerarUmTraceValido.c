@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "fiber.h"
+
+#define MAX_FIBERS 64
+
+// Verificador mínimo da sintaxe JSON; avança *p pelo valor e retorna 0 se válido
+int valor(const char **p);
+
+void espacos(const char **p)
+{
+    while (isspace((unsigned char)**p))
+        (*p)++;
+}
+
+int texto(const char **p)
+{
+    if (**p != '"')
+        return -1;
+    for ((*p)++; **p != '"'; (*p)++)
+    {
+        if (**p == '\0' || (unsigned char)**p < 0x20)
+            return -1;
+        if (**p == '\\' && *++(*p) == '\0')
+            return -1;
+    }
+    (*p)++;
+    return 0;
+}
+
+int valor(const char **p)
+{
+    espacos(p);
+
+    if (**p == '{' || **p == '[')
+    {
+        char fim = **p == '{' ? '}' : ']';
+        int objeto = **p == '{';
+
+        (*p)++;
+        espacos(p);
+        if (**p == fim)
+        {
+            (*p)++;
+            return 0;
+        }
+
+        for (;;)
+        {
+            if (objeto)
+            {
+                espacos(p);
+                if (texto(p) == -1)
+                    return -1;
+                espacos(p);
+                if (*(*p)++ != ':')
+                    return -1;
+            }
+            if (valor(p) == -1)
+                return -1;
+            espacos(p);
+            if (**p == fim)
+            {
+                (*p)++;
+                return 0;
+            }
+            if (*(*p)++ != ',')
+                return -1;
+        }
+    }
+
+    if (**p == '"')
+        return texto(p);
+
+    char *fim;
+    strtod(*p, &fim);
+    if (fim != *p)
+    {
+        *p = fim;
+        return 0;
+    }
+
+    return -1;
+}
+
+void *cede(void *arg)
+{
+    for (int i = 0; i < 3; i++)
+        fiber_yield();
+
+    return NULL;
+}
+
+void *dorme(void *arg)
+{
+    fiber_sleep(1000);
+
+    return NULL;
+}
+
+void *gira(void *arg)
+{
+    volatile long i = 0;
+    while (++i < 100000000);
+
+    return NULL;
+}
+
+int main(int argc, char const *argv[])
+{
+    fiber_t fibers[3];
+
+    fiber_trace_start(NULL);
+
+    fiber_create(&fibers[0], cede, NULL);
+    fiber_create(&fibers[1], dorme, NULL);
+    fiber_create(&fibers[2], gira, NULL);
+    for (int i = 0; i < 3; i++)
+        fiber_join(fibers[i], NULL);
+
+    fiber_trace_stop();
+
+    FILE *out = tmpfile();
+    if (out == NULL || fiber_trace_dump(out) != 0)
+    {
+        printf("falhou: fiber_trace_dump\n");
+        return -1;
+    }
+
+    long size = ftell(out);
+    char *json = malloc(size + 1);
+    rewind(out);
+    if (json == NULL || fread(json, 1, size, out) != (size_t)size)
+    {
+        printf("falhou: não leu o trace\n");
+        return -1;
+    }
+    json[size] = '\0';
+
+    const char *p = json;
+    if (valor(&p) == -1 || (espacos(&p), *p != '\0'))
+    {
+        printf("falhou: JSON inválido perto de \"%.40s\"\n", p);
+        return -1;
+    }
+
+    // Cada fiber alterna entre B e E, e termina sem fatia aberta
+    int aberta[MAX_FIBERS] = {0};
+    int fatias = 0;
+    for (char *linha = strtok(json, "\n"); linha != NULL; linha = strtok(NULL, "\n"))
+    {
+        char *tid = strstr(linha, "\"tid\":");
+        int b = strstr(linha, "\"ph\":\"B\"") != NULL;
+        int e = strstr(linha, "\"ph\":\"E\"") != NULL;
+        if (tid == NULL || !(b || e))
+            continue;
+
+        long id = atol(tid + 6);
+        if (id < 0 || id >= MAX_FIBERS || aberta[id] == b)
+        {
+            printf("falhou: evento %s fora de ordem na fiber %ld\n", b ? "B" : "E", id);
+            return -1;
+        }
+        aberta[id] = b;
+        fatias += e;
+    }
+
+    for (int i = 0; i < MAX_FIBERS; i++)
+    {
+        if (aberta[i])
+        {
+            printf("falhou: fatia da fiber %d sem E\n", i);
+            return -1;
+        }
+    }
+
+    if (fatias < 8)
+    {
+        printf("falhou: só %d fatias no trace\n", fatias);
+        return -1;
+    }
+
+    printf("ok: %d fatias\n", fatias);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <string.h>
+#include "fiber.h"
+
+// Bytes de pilha usados por cada rotina
+#define PEQUENA 1000
+#define GRANDE 20000
+
+void *usa_pouco(void *arg)
+{
+    volatile char buffer[PEQUENA];
+    memset((char *)buffer, 1, sizeof(buffer));
+
+    return NULL;
+}
+
+void *usa_muito(void *arg)
+{
+    volatile char buffer[GRANDE];
+    memset((char *)buffer, 1, sizeof(buffer));
+
+    return NULL;
+}
+
+int main(int argc, char const *argv[])
+{
+    fiber_t pouco[3], muito;
+    fiber_stack_stats_t stats;
+
+    fiber_stack_profile_start();
+
+    for (int i = 0; i < 3; i++)
+        if (fiber_create(&pouco[i], usa_pouco, NULL) == -1)
+            perror("cannot create a fiber\n");
+    if (fiber_create(&muito, usa_muito, NULL) == -1)
+        perror("cannot create a fiber\n");
+
+    // Só uma é esperada; as outras terminam sem fiber_join e também são medidas
+    fiber_join(pouco[0], NULL);
+    fiber_join(muito, NULL);
+    fiber_yield();
+
+    if (fiber_stack_stats(usa_pouco, &stats) != 0 || stats.count != 3)
+    {
+        printf("falhou: %lu fibers de usa_pouco medidas em vez de 3\n", stats.count);
+        return -1;
+    }
+    if (stats.max < PEQUENA || stats.max >= GRANDE || stats.total < 3 * PEQUENA || stats.total > 3 * stats.max)
+    {
+        printf("falhou: usa_pouco com max %zu e total %zu\n", stats.max, stats.total);
+        return -1;
+    }
+
+    if (fiber_stack_stats(usa_muito, &stats) != 0 || stats.count != 1 || stats.max < GRANDE)
+    {
+        printf("falhou: usa_muito com %lu fibers e max %zu\n", stats.count, stats.max);
+        return -1;
+    }
+
+    // Toda fiber medida cai em exatamente um balde do histograma
+    unsigned long baldes = 0;
+    for (int i = 0; i < FIBER_STACK_BUCKETS; i++)
+        baldes += stats.histogram[i];
+    if (baldes != stats.count)
+    {
+        printf("falhou: %lu fibers no histograma em vez de %lu\n", baldes, stats.count);
+        return -1;
+    }
+
+    fiber_stack_profile_stop();
+
+    printf("ok\n");
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "fiber.h"
+
+int pipefd[2];
+fiber_t dorminhoca;
+
+void *dorme(void *arg)
+{
+    fiber_sleep(100000);
+
+    return NULL;
+}
+
+void *espera_dorminhoca(void *arg)
+{
+    fiber_join(dorminhoca, NULL);
+
+    return NULL;
+}
+
+void *le(void *arg)
+{
+    char c;
+
+    fiber_wait_io(pipefd[0], EPOLLIN);
+    read(pipefd[0], &c, 1);
+
+    return NULL;
+}
+
+int main(int argc, char const *argv[])
+{
+    fiber_t espera, leitora;
+    char retrato[4096];
+    char descritor[32];
+
+    if (pipe(pipefd) == -1)
+    {
+        perror("cannot create a pipe\n");
+        return -1;
+    }
+
+    if (fiber_create(&dorminhoca, dorme, NULL) == -1 ||
+        fiber_create(&espera, espera_dorminhoca, NULL) == -1 ||
+        fiber_create(&leitora, le, NULL) == -1)
+    {
+        perror("cannot create a fiber\n");
+        return -1;
+    }
+
+    // Deixa as três fibers chegarem ao ponto em que bloqueiam
+    for (int i = 0; i < 3; i++)
+        fiber_yield();
+
+    FILE *out = tmpfile();
+    if (out == NULL)
+    {
+        perror("cannot create a file\n");
+        return -1;
+    }
+
+    fiber_dump(out);
+
+    rewind(out);
+    size_t size = fread(retrato, 1, sizeof(retrato) - 1, out);
+    retrato[size] = '\0';
+    fclose(out);
+
+    snprintf(descritor, sizeof(descritor), " fd %d", pipefd[0]);
+
+    if (strstr(retrato, " join fiber ") == NULL)
+    {
+        printf("falhou: o retrato não mostra a fiber esperando a fiber_join\n");
+        return -1;
+    }
+    if (strstr(retrato, descritor) == NULL)
+    {
+        printf("falhou: o retrato não mostra a fiber esperando o descritor\n");
+        return -1;
+    }
+    if (strstr(retrato, " timer ") == NULL)
+    {
+        printf("falhou: o retrato não mostra a fiber esperando o timer\n");
+        return -1;
+    }
+
+    write(pipefd[1], "x", 1);
+    fiber_join(espera, NULL);
+    fiber_join(leitora, NULL);
+
+    printf("ok\n");
+
+    return 0;
+}
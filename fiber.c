@@ -1,10 +1,25 @@
+#define _GNU_SOURCE // REG_RIP e REG_RBP do ucontext_t
+
 #include <stdio.h>
 #include <ucontext.h>
 #include <stdlib.h>
 #include <sys/time.h>
 #include <signal.h>
-
-typedef void *fiber_t; // tipo para ID de fiber
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <execinfo.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "fiber.h"
 
 #define FIBER_STACK_SIZE 1024 * 64
 
@@ -15,6 +30,31 @@ typedef void *fiber_t; // tipo para ID de fiber
 #define STATE_BLOCKED 1
 #define STATE_FINISHED 2
 
+#define SCHED_MAX_POLICIES 16 // quantidade máxima de políticas registradas
+
+#define STACK_CANARY 0xA5 // byte usado para pintar as pilhas no profiling
+
+#define IDLE_MAX_EVENTS 64 // eventos tratados por chamada da epoll_wait
+#define IDLE_IO_INTERVAL_NS (TIME_SLICE_USEC * 1000ULL) // intervalo mínimo entre consultas aos descritores
+
+#define FIBER_CACHE_LINE 64 // tamanho da linha de cache e do cabeçalho da fiber
+#define FIBER_SLAB_SIZE 256 // cabeçalhos de fiber alocados de uma vez
+
+#define PARALLEL_FOR_CHUNKS 8 // pedaços por processador quando o grain não é dado
+
+#define DUMP_MAX_FRAMES 32 // quadros por backtrace na fiber_dump
+
+#define TRACE_BUFFER_SIZE (1 << 16) // quantidade de eventos no buffer; potência de 2
+
+#define TRACE_CREATE 0
+#define TRACE_RUN 1
+#define TRACE_PREEMPT 2
+#define TRACE_BLOCK 3
+#define TRACE_WAKE 4
+#define TRACE_EXIT 5
+#define TRACE_YIELD 6
+#define TRACE_STOP 7
+
 /**
  * @struct Waiting
  * 
@@ -30,30 +70,195 @@ typedef struct Waiting
 } Waiting;
 
 /**
- * @struct Fiber
+ * @struct Cleanup
  * 
- * @brief  Estrutura de uma fiber (thread no espaço do usuário). Implementa a lista
- * circular para o algoritmo de preempção round robin.
+ * @brief  Rotina de limpeza registrada pela fiber_cleanup_push(). Forma uma pilha
+ * que é executada quando a fiber termina ou é cancelada.
  * 
- * @param next      ponteiro para outra estrutura na lista.
- * @param context   ponteiro para o contexto de execução da fiber.
- * @param status    estado atual da fiber; STATE_READY a fiber está pronta para ser
- * executada; STATE_BLOCKED a fiber está em espera; STATE_FINISHED fiber finalizada
+ * @param routine   rotina de limpeza.
+ * @param arg       argumento passado para a rotina.
+ * @param next      próxima rotina da pilha.
+*/
+typedef struct Cleanup
+{
+    void (*routine)(void *); // rotina de limpeza
+    void *arg;               // argumento da rotina
+    struct Cleanup *next;    // próxima rotina da pilha
+} Cleanup;
+
+/**
+ * @struct Fiber_Cold
+ * 
+ * @brief  Campos da fiber raramente usados pelo escalonador. Ficam fora do
+ * cabeçalho da fiber, logo acima da pilha, no mesmo bloco alocado para ela.
+ * 
+ * @param context   contexto de execução da fiber.
+ * @param id        número sequencial da fiber, usado no tracing.
  * @param retval    ponteiro que armazena o endereço do valor de retorno.
  * @param join_rval ponteiro que armazena o endereço do valor  de retorno  da fiber
  * que está sendo aguardada.
+ * @param joinFiber fiber que esta fiber está esperando.
  * @param waitList  lista de fibers que estão aguardando essa fiber.
+ * @param start_routine rotina executada pela fiber.
+ * @param arg       argumento passado para a rotina.
+ * @param sched_data dado livre para políticas registradas pelo usuário.
+ * @param cancel    indica que o cancelamento da fiber foi pedido.
+ * @param waitNode  nodo desta fiber na waitList da joinFiber, enquanto espera.
+ * @param cleanup   pilha de rotinas de limpeza da fiber.
+ * @param stack_painted indica que a pilha foi pintada com STACK_CANARY.
+ * @param group     grupo ao qual a fiber pertence.
+ * @param group_prev fiber anterior na lista de filhas vivas do grupo.
+ * @param group_next próxima fiber na lista de filhas vivas do grupo.
+ * @param waitGroup grupo que esta fiber está esperando.
+ * @param waitFuture future que esta fiber está esperando.
+ * @param waitFd    descritor que a fiber está esperando; -1 se nenhum.
+ * @param io_events eventos que acordaram a fiber_wait_io.
+ * @param io_wait   eventos que a fiber espera no waitFd.
+ * @param io_next   próxima fiber esperando o mesmo descritor.
+ * @param parked    indica que a fiber está bloqueada na fiber_park.
+ * @param permit    permissão deixada pela fiber_unpark; consumida pela fiber_park.
+ * @param remote_queued indica que a fiber está na lista de despertares remotos.
+ * @param remote_next próxima fiber na lista de despertares remotos.
+ * @param run_ns    tempo total em execução, em nanosegundos.
+*/
+typedef struct Fiber_Cold
+{
+    ucontext_t context;             // contexto da fiber
+    unsigned long id;               // número sequencial da fiber
+    void *retval;                   // valor de retorno da fiber
+    void *join_rval;                // valor de retorno da fiber que ela estava esperando
+    struct Fiber *joinFiber;        // ponteiro para a fiber que essa fiber está esperando
+    Waiting *waitList;              // lista de head que estão esperando essa fiber
+    void *(*start_routine)(void *); // rotina da fiber
+    void *arg;                      // argumento da rotina
+    void *(*routine)(void *);       // rotina do usuário; chave do profiling e da fiber_dump
+    void *sched_data;               // dado da política de escalonamento
+    int cancel;                     // cancelamento pendente
+    Waiting *waitNode;              // nodo na waitList da joinFiber
+    Cleanup *cleanup;               // pilha de rotinas de limpeza
+    int stack_painted;              // pilha pintada para o profiling
+    struct Fiber_Group *group;      // grupo da fiber
+    struct Fiber *group_prev;       // fiber anterior no grupo
+    struct Fiber *group_next;       // próxima fiber no grupo
+    struct Group_Result *group_result; // resultado reservado na fiber_group_spawn
+    struct Fiber_Group *waitGroup;  // grupo que essa fiber está esperando
+    struct Future *waitFuture;      // future que essa fiber está esperando
+    int waitFd;                     // descritor esperado
+    int io_events;                  // eventos recebidos do descritor
+    int io_wait;                    // eventos esperados do descritor
+    struct Fiber *io_next;          // próxima fiber esperando o descritor
+    int parked;                     // bloqueada na fiber_park
+    int permit;                     // permissão da fiber_unpark
+    int remote_queued;              // está na lista de despertares remotos
+    struct Fiber *remote_next;      // próxima na lista de despertares remotos
+    unsigned long long run_ns;      // tempo em execução
+    int detached;                   // desalocada ao terminar, sem fiber_join
+    int preempted;                  // interrompida pelo timer; registradores abaixo
+    uintptr_t preempt_pc;           // rip no instante da interrupção
+    uintptr_t preempt_fp;           // rbp no instante da interrupção
+    uintptr_t preempt_sp;           // rsp no instante da interrupção
+} Fiber_Cold;
+
+/**
+ * @struct Fiber
+ * 
+ * @brief  Cabeçalho de uma fiber (thread no espaço do usuário) com os campos lidos
+ * pelo escalonador a cada troca. Ocupa exatamente uma linha de cache e é alocado
+ * em blocos contíguos pela fiber_alloc(); o restante fica na Fiber_Cold.
+ * 
+ * @param next      ponteiro para outra estrutura na lista.
+ * @param prev      ponteiro para a estrutura anterior na lista.
+ * @param rq_next   próxima fiber na fila de prontos das políticas nativas.
+ * @param wake_at   instante em nanosegundos em que a fiber_sleep termina; 0 se não dorme.
+ * @param deadline  prazo absoluto da fiber em nanosegundos; usado pela "edf".
+ * @param cold      campos raramente usados da fiber.
+ * @param status    estado atual da fiber; STATE_READY a fiber está pronta para ser
+ * executada; STATE_BLOCKED a fiber está em espera; STATE_FINISHED fiber finalizada
+ * @param priority  prioridade da fiber; usada pela política "priority".
+ * @param timer_index posição da fiber no heap de timers; -1 se não dorme.
 */
 typedef struct Fiber
 {
-    struct Fiber *next;      // próxima fiber da lista
-    ucontext_t context;      // contexto da fiber
-    int status;              // status da fiber
-    void *retval;            // valor de retorno da fiber
-    void *join_rval;         // valor de retorno da fiber que ela estava esperando
-    struct Fiber *joinFiber; // ponteiro para a fiber que essa fiber está esperando
-    Waiting *waitList;       // lista de head que estão esperando essa fiber
-} Fiber;
+    struct Fiber *next;          // próxima fiber da lista
+    struct Fiber *prev;          // fiber anterior da lista
+    struct Fiber *rq_next;       // próxima fiber na fila de prontos
+    unsigned long long wake_at;  // fim da fiber_sleep
+    unsigned long long deadline; // prazo absoluto da fiber
+    Fiber_Cold *cold;            // campos frios da fiber
+    int status;                  // status da fiber
+    int priority;                // prioridade da fiber
+    int timer_index;             // posição no heap de timers
+} __attribute__((aligned(FIBER_CACHE_LINE))) Fiber;
+
+_Static_assert(sizeof(Fiber) == FIBER_CACHE_LINE, "o cabeçalho da fiber deve ocupar uma linha de cache");
+
+/**
+ * @struct Group_Result
+ * 
+ * @brief  Resultado de uma fiber de um grupo que já terminou.
+ * 
+ * @param fiber     identificador da fiber (já desalocada).
+ * @param retval    valor de retorno da fiber.
+ * @param next      próximo resultado, na ordem de término.
+*/
+typedef struct Group_Result
+{
+    fiber_t fiber;             // identificador da fiber
+    void *retval;              // valor de retorno da fiber
+    struct Group_Result *next; // próximo resultado
+} Group_Result;
+
+/**
+ * @struct Fiber_Group
+ * 
+ * @brief  Grupo de fibers filhas de uma fiber, para esperar todas de uma vez ou a
+ * primeira que terminar.
+ * 
+ * @param children  lista duplamente encadeada das filhas ainda vivas.
+ * @param live      quantidade de filhas vivas.
+ * @param waiter    fiber bloqueada na join_all ou wait_any do grupo.
+ * @param wait_any  indica que o waiter deve acordar no primeiro término.
+ * @param head      primeiro resultado ainda não consumido pela wait_any.
+ * @param tail      último resultado.
+ * @param destroyed destruição pedida com filhas ainda vivas.
+*/
+typedef struct Fiber_Group
+{
+    Fiber *children;    // filhas vivas
+    int live;           // quantidade de filhas vivas
+    Fiber *waiter;      // fiber esperando o grupo
+    int wait_any;       // espera pelo primeiro término
+    Group_Result *head; // primeiro resultado
+    Group_Result *tail; // último resultado
+    int destroyed;      // destruição adiada
+} Fiber_Group;
+
+/**
+ * @struct Future
+ * 
+ * @brief  Resultado futuro de uma rotina executada em uma fiber pela fiber_async()
+ * ou pela future_then().
+ * 
+ * @param start_routine rotina que produz o valor.
+ * @param arg       argumento da rotina; na future_then, o valor da future anterior.
+ * @param ready     indica que o valor já foi produzido.
+ * @param value     valor produzido pela rotina.
+ * @param waitList  fibers bloqueadas na future_get().
+ * @param then      primeira continuação registrada pela future_then().
+ * @param then_next próxima continuação da mesma future.
+ * @param destroyed destruição pedida antes do valor ficar pronto.
+*/
+typedef struct Future
+{
+    void *(*start_routine)(void *); // rotina que produz o valor
+    void *arg;                      // argumento da rotina
+    int ready;                      // valor pronto
+    void *value;                    // valor produzido
+    Waiting *waitList;              // fibers esperando o valor
+    struct Future *then;            // continuações
+    struct Future *then_next;       // próxima continuação
+    int destroyed;                  // destruição adiada
+} Future;
 
 /**
  * @struct Fiber_List
@@ -65,6 +270,7 @@ typedef struct Fiber
  * @param tail      ponteiro para a última fiber da lista; para a cauda.
  * @param running   ponteiro para a fiber em execução.
  * @param size      quantidade de elementos inseridos na lista.
+ * @param zombies   fibers finalizadas aguardando fiber_join ou fiber_destroy.
 */
 typedef struct Fiber_List
 {
@@ -72,6 +278,7 @@ typedef struct Fiber_List
     Fiber *tail;    // última fiber(cauda) da lista.
     Fiber *running; // fiber sendo executada no momento
     int size;       // tamanho da lista
+    int zombies;    // fibers finalizadas ainda não desalocadas
 } Fiber_List;
 
 // Lista de fibers
@@ -83,16 +290,331 @@ ucontext_t scheduler_ctx, parent_ctx;
 // Timer do escalonador
 struct itimerval timer;
 
+// Próximo id sequencial a ser atribuído a uma fiber
+unsigned long fiber_next_id = 1;
+
+// Instante em que a fiber em execução recebeu a CPU
+unsigned long long run_start = 0;
+
+// Topo da pilha do processo, usada pela fiber principal; limite do seu backtrace
+uintptr_t main_stack_high = 0;
+
+// Pedido de fiber_dump feito pelo sinal instalado na fiber_dump_on_signal()
+volatile sig_atomic_t dump_requested = 0;
+
+/**
+ * @struct Trace_Event
+ * 
+ * @brief  Evento registrado pelo tracing.
+ * 
+ * @param tsc       instante do evento, em ticks do TSC.
+ * @param fiber     id da fiber associada ao evento.
+ * @param type      tipo do evento (TRACE_CREATE, TRACE_RUN, ...).
+*/
+typedef struct Trace_Event
+{
+    unsigned long long tsc; // instante do evento
+    unsigned long fiber;    // id da fiber
+    int type;               // tipo do evento
+} Trace_Event;
+
+/**
+ * @struct Trace_Buffer
+ * 
+ * @brief  Buffer circular de eventos de tracing, um por thread. Só a própria thread
+ * escreve nele; a posição é reservada com um incremento atômico, de modo que o
+ * handler do SIGVTALRM pode interromper uma escrita sem corromper o buffer.
+ * 
+ * @param events    vetor com TRACE_BUFFER_SIZE eventos.
+ * @param head      quantidade de eventos já registrados (nunca volta a zero).
+ * @param tsc_start leitura do TSC no início do tracing.
+ * @param ns_start  leitura do relógio monotônico no início do tracing.
+ * @param path      arquivo onde o trace será salvo ao final do processo.
+*/
+typedef struct Trace_Buffer
+{
+    Trace_Event *events;          // eventos registrados
+    unsigned long head;           // total de eventos registrados
+    unsigned long long tsc_start; // TSC no início do tracing
+    unsigned long long ns_start;  // relógio monotônico no início do tracing
+    char *path;                   // arquivo de saída no exit
+} Trace_Buffer;
+
+// Indica se o tracing está ativo
+int trace_enabled = 0;
+
+// Buffer de tracing da thread
+__thread Trace_Buffer trace_buffer;
+
+/**
+ * @brief Registra um evento de tracing. Quando o tracing está desligado custa
+ * apenas um desvio previsível.
+*/
+#define TRACE(type, fiber)                         \
+    do                                             \
+    {                                              \
+        if (__builtin_expect(trace_enabled, 0))    \
+            trace_record((type), (fiber));         \
+    } while (0)
+
+/**
+ * @name   trace_now_ns()
+ * 
+ * @brief  Lê o relógio monotônico.
+ * 
+ * @return instante atual em nanosegundos.
+*/
+unsigned long long trace_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @name   trace_tsc()
+ * 
+ * @brief  Lê o contador de ticks do processador. Em arquiteturas sem TSC usa o
+ * relógio monotônico.
+ * 
+ * @return valor atual do contador.
+*/
+static inline unsigned long long trace_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return trace_now_ns();
+#endif
+}
+
+/**
+ * @name   trace_record(int type, struct Fiber *fiber)
+ * 
+ * @brief  Insere um evento no buffer da thread. Quando o buffer está cheio os
+ * eventos mais antigos são sobrescritos.
+ * 
+ * @param type  tipo do evento.
+ * @param fiber fiber associada ao evento.
+*/
+void trace_record(int type, struct Fiber *fiber)
+{
+    if (trace_buffer.events == NULL)
+        return;
+
+    unsigned long slot = __atomic_fetch_add(&trace_buffer.head, 1, __ATOMIC_RELAXED);
+    Trace_Event *event = &trace_buffer.events[slot & (TRACE_BUFFER_SIZE - 1)];
+
+    event->tsc = trace_tsc();
+    event->fiber = fiber->cold->id;
+    event->type = type;
+}
+
+/**
+ * @struct Run_Queue
+ * 
+ * @brief  Fila FIFO de fibers prontas, encadeada pelo campo rq_next da fiber.
+ * 
+ * @param head      primeira fiber da fila.
+ * @param tail      última fiber da fila.
+*/
+typedef struct Run_Queue
+{
+    Fiber *head; // primeira fiber da fila
+    Fiber *tail; // última fiber da fila
+} Run_Queue;
+
+/**
+ * @name   rq_push(Run_Queue *queue, Fiber *fiber)
+ * 
+ * @brief  Insere a fiber no final da fila.
+*/
+void rq_push(Run_Queue *queue, Fiber *fiber)
+{
+    fiber->rq_next = NULL;
+
+    if (queue->tail == NULL)
+        queue->head = fiber;
+    else
+        queue->tail->rq_next = fiber;
+
+    queue->tail = fiber;
+}
+
+/**
+ * @name   rq_pop(Run_Queue *queue)
+ * 
+ * @brief  Remove a fiber do início da fila.
+ * 
+ * @return fiber removida; NULL caso a fila esteja vazia.
+*/
+Fiber *rq_pop(Run_Queue *queue)
+{
+    Fiber *fiber = queue->head;
+
+    if (fiber == NULL)
+        return NULL;
+
+    queue->head = fiber->rq_next;
+    if (queue->head == NULL)
+        queue->tail = NULL;
+
+    fiber->rq_next = NULL;
+
+    return fiber;
+}
+
+// Fila de prontos das políticas "fifo", "rr" e "edf"
+Run_Queue sched_queue;
+
+// Filas por nível de prioridade da política "priority" e o bitmap dos níveis não vazios
+Run_Queue sched_prio_queues[FIBER_PRIORITY_LEVELS];
+unsigned int sched_prio_bitmap = 0;
+
+void sched_fifo_enqueue(fiber_t fiber)
+{
+    rq_push(&sched_queue, fiber);
+}
+
+fiber_t sched_fifo_pick_next()
+{
+    return rq_pop(&sched_queue);
+}
+
+/**
+ * @brief A fifo nunca preempta: a fiber executa até bloquear ou terminar.
+*/
+int sched_fifo_on_tick(fiber_t fiber)
+{
+    return 0;
+}
+
+/**
+ * @brief O round robin preempta a fiber a cada time slice.
+*/
+int sched_rr_on_tick(fiber_t fiber)
+{
+    return 1;
+}
+
+void sched_prio_enqueue(fiber_t fiber)
+{
+    int level = ((Fiber *)fiber)->priority;
+
+    rq_push(&sched_prio_queues[level], fiber);
+    sched_prio_bitmap |= 1U << level;
+}
+
+/**
+ * @brief Retira a fiber do nível não vazio de maior prioridade.
+*/
+fiber_t sched_prio_pick_next()
+{
+    if (sched_prio_bitmap == 0)
+        return NULL;
+
+    int level = 31 - __builtin_clz(sched_prio_bitmap);
+    Fiber *fiber = rq_pop(&sched_prio_queues[level]);
+
+    if (sched_prio_queues[level].head == NULL)
+        sched_prio_bitmap &= ~(1U << level);
+
+    return fiber;
+}
+
+/**
+ * @brief Insere a fiber ordenada pelo prazo; fibers sem prazo (0) ficam no fim.
+*/
+void sched_edf_enqueue(fiber_t fiber)
+{
+    Fiber *node = fiber;
+    unsigned long long deadline = node->deadline ? node->deadline : ~0ULL;
+
+    Fiber *prev = NULL;
+    Fiber *curr = sched_queue.head;
+    while (curr != NULL && (curr->deadline ? curr->deadline : ~0ULL) <= deadline)
+    {
+        prev = curr;
+        curr = curr->rq_next;
+    }
+
+    node->rq_next = curr;
+    if (prev == NULL)
+        sched_queue.head = node;
+    else
+        prev->rq_next = node;
+    if (curr == NULL)
+        sched_queue.tail = node;
+}
+
+// Políticas nativas
+const fiber_sched_policy_t sched_fifo = {"fifo", sched_fifo_enqueue, sched_fifo_pick_next, NULL, NULL, sched_fifo_on_tick};
+const fiber_sched_policy_t sched_rr = {"rr", sched_fifo_enqueue, sched_fifo_pick_next, NULL, NULL, sched_rr_on_tick};
+const fiber_sched_policy_t sched_prio = {"priority", sched_prio_enqueue, sched_prio_pick_next, NULL, NULL, sched_rr_on_tick};
+const fiber_sched_policy_t sched_edf = {"edf", sched_edf_enqueue, sched_fifo_pick_next, NULL, NULL, sched_rr_on_tick};
+
+// Políticas disponíveis para a fiber_sched_set_policy()
+const fiber_sched_policy_t *sched_policies[SCHED_MAX_POLICIES] = {&sched_fifo, &sched_rr, &sched_prio, &sched_edf};
+int sched_policies_size = 4;
+
+// Política em uso; o padrão é o round robin
+const fiber_sched_policy_t *sched_policy = &sched_rr;
+
+/**
+ * @name   sched_wake(Fiber *fiber)
+ * 
+ * @brief  Marca uma fiber bloqueada como pronta e a devolve para a política.
+ * 
+ * @param  fiber fiber que será acordada.
+*/
+void sched_wake(Fiber *fiber)
+{
+    fiber->status = STATE_READY;
+
+    TRACE(TRACE_WAKE, fiber);
+
+    if (sched_policy->on_wake != NULL)
+        sched_policy->on_wake(fiber);
+
+    sched_policy->enqueue(fiber);
+}
+
 /**
- * @name   preempt()
+ * @name   preempt(int signo, siginfo_t *info, void *ucontext)
  * 
  * @brief  Handler do sinal SIGVTALRM lançado  pelo timer  quando expirado. Salva o
- * contexto da fiber atual e troca para o contexto do escalonador.
+ * contexto da fiber atual e troca para o contexto do escalonador, caso o on_tick
+ * da política permita. Os registradores do ponto interrompido, recebidos no
+ * ucontext do sinal, são guardados para o backtrace da fiber_dump. Um retrato
+ * pedido por sinal força a troca, mesmo que a política não preempte, para que o
+ * escalonador o escreva fora do handler.
  * 
- * @return identificador da fiber.
+ * @param  ucontext contexto interrompido pelo sinal.
 */
-void preempt()
+void preempt(int signo, siginfo_t *info, void *ucontext)
 {
+    (void)signo;
+    (void)info;
+
+    Fiber *running = fiber_list->running;
+
+#if defined(__x86_64__)
+    greg_t *gregs = ((ucontext_t *)ucontext)->uc_mcontext.gregs;
+    running->cold->preempt_pc = gregs[REG_RIP];
+    running->cold->preempt_fp = gregs[REG_RBP];
+    running->cold->preempt_sp = gregs[REG_RSP];
+    running->cold->preempted = 1;
+#else
+    (void)ucontext;
+#endif
+
+    // A política decide se a fiber perde a CPU ao fim do time slice
+    if (!dump_requested && sched_policy->on_tick != NULL && !sched_policy->on_tick(running))
+    {
+        running->cold->preempted = 0;
+        return;
+    }
+
     /**
      * swapcontext(ucontext_t *oucp, const ucontext_t *ucp);
      * 
@@ -100,11 +622,12 @@ void preempt()
      * execução  que é  apontado  pela  variável ucp.  Em outras palavras, troca o 
      * contexto atual (oucp) pelo contexto em ucp.
     */
-    if (swapcontext(&fiber_list->running->context, &scheduler_ctx) == -1)
-    {
+    TRACE(TRACE_PREEMPT, running);
+
+    if (swapcontext(&running->cold->context, &scheduler_ctx) == -1)
         perror("swapcontext failed at preempt.");
-        return;
-    }
+
+    running->cold->preempted = 0;
 }
 
 /**
@@ -178,9 +701,13 @@ void start_timer()
  * @brief  Libera todas as fibers da lista de espera para que sejam executadas.
  * 
  * @param waitingList - lista de espera das fibers.
+ * 
+ * @return quantidade de fibers liberadas.
 */
-void release_fibers(Waiting *waitingList)
+int release_fibers(Waiting *waitingList)
 {
+    int released = 0;
+
     // Enquanto houver fiber esperando
     while (waitingList != NULL)
     {
@@ -191,22 +718,168 @@ void release_fibers(Waiting *waitingList)
         // Se a fiber existir e estiver esperando
         if (waitingFiber != NULL && waitingFiber->status == STATE_BLOCKED)
         {
+            // Guarda o retval; a fiber aguardada será desalocada em seguida
+            waitingFiber->cold->join_rval = waitingFiber->cold->joinFiber->cold->retval;
+            waitingFiber->cold->joinFiber = NULL;
+            waitingFiber->cold->waitNode = NULL;
             // Libera a fiber
-            waitingFiber->status = STATE_READY;
-            // Guarda o retval
-            waitingFiber->join_rval = waitingFiber->joinFiber->retval;
+            sched_wake(waitingFiber);
+            released++;
         }
         // Libera o nodo no topo
         free(waitingList);
         // Vai para o próximo nodo
         waitingList = waitingNode;
     }
+
+    return released;
+}
+
+/**
+ * @struct Stack_Profile
+ * 
+ * @brief  Uso de pilha agregado das fibers de uma mesma rotina.
+ * 
+ * @param start_routine rotina das fibers medidas.
+ * @param stats     estatísticas acumuladas.
+ * @param next      próximo elemento da lista.
+*/
+typedef struct Stack_Profile
+{
+    void *(*start_routine)(void *); // rotina das fibers
+    fiber_stack_stats_t stats;      // estatísticas acumuladas
+    struct Stack_Profile *next;     // próximo elemento da lista
+} Stack_Profile;
+
+// Indica se as pilhas das novas fibers devem ser pintadas
+int stack_profile_enabled = 0;
+
+// Estatísticas de uso de pilha, uma por rotina
+Stack_Profile *stack_profiles = NULL;
+
+/**
+ * @name   stack_high_water(Fiber *fiber)
+ * 
+ * @brief  Mede o maior uso da pilha da fiber. A pilha cresce em direção ao início
+ * do bloco, então o primeiro byte que não tem mais o STACK_CANARY marca o ponto
+ * mais profundo já alcançado.
+ * 
+ * @return quantidade de bytes usados.
+*/
+size_t stack_high_water(Fiber *fiber)
+{
+    unsigned char *stack = fiber->cold->context.uc_stack.ss_sp;
+    size_t size = fiber->cold->context.uc_stack.ss_size;
+    size_t offset = 0;
+
+    while (offset < size && stack[offset] == STACK_CANARY)
+        offset++;
+
+    return size - offset;
+}
+
+/**
+ * @name   stack_profile_record(Fiber *fiber)
+ * 
+ * @brief  Mede a pilha da fiber e acumula o resultado nas estatísticas da sua
+ * rotina. Fibers cuja pilha não foi pintada são ignoradas.
+ * 
+ * @param  fiber fiber finalizada.
+*/
+void stack_profile_record(Fiber *fiber)
+{
+    if (!fiber->cold->stack_painted)
+        return;
+
+    Stack_Profile *profile = stack_profiles;
+    while (profile != NULL && profile->start_routine != fiber->cold->routine)
+        profile = profile->next;
+
+    if (profile == NULL)
+    {
+        profile = calloc(1, sizeof(Stack_Profile));
+        if (profile == NULL)
+        {
+            perror("malloc failed at stack_profile_record.");
+            return;
+        }
+
+        profile->start_routine = fiber->cold->routine;
+        profile->next = stack_profiles;
+        stack_profiles = profile;
+    }
+
+    size_t used = stack_high_water(fiber);
+
+    int bucket = 0;
+    while (bucket < FIBER_STACK_BUCKETS - 1 && used > (size_t)FIBER_STACK_BUCKET_MIN << bucket)
+        bucket++;
+
+    profile->stats.count++;
+    profile->stats.total += used;
+    if (used > profile->stats.max)
+        profile->stats.max = used;
+    profile->stats.histogram[bucket]++;
+}
+
+// Cabeçalhos de fiber livres, encadeados pelo campo next em ordem de liberação
+Fiber *fiber_free_list = NULL;
+Fiber *fiber_free_tail = NULL;
+
+/**
+ * @name   fiber_alloc()
+ * 
+ * @brief  Aloca o cabeçalho de uma fiber. Os cabeçalhos são alocados em blocos
+ * de FIBER_SLAB_SIZE, alinhados à linha de cache, para que fibers criadas em
+ * sequência fiquem contíguas na memória. O cabeçalho reutilizado é o liberado há
+ * mais tempo, adiando o reaproveitamento de identificadores de fibers destruídas.
+ * 
+ * @return cabeçalho alocado; NULL para falha.
+*/
+Fiber *fiber_alloc()
+{
+    if (fiber_free_list == NULL)
+    {
+        Fiber *slab = aligned_alloc(FIBER_CACHE_LINE, FIBER_SLAB_SIZE * sizeof(Fiber));
+        if (slab == NULL)
+            return NULL;
+
+        // Encadeia de trás para frente para entregar os cabeçalhos em ordem crescente
+        for (int i = FIBER_SLAB_SIZE - 1; i >= 0; i--)
+        {
+            slab[i].next = fiber_free_list;
+            fiber_free_list = &slab[i];
+        }
+        fiber_free_tail = &slab[FIBER_SLAB_SIZE - 1];
+    }
+
+    Fiber *fiber = fiber_free_list;
+    fiber_free_list = fiber->next;
+    if (fiber_free_list == NULL)
+        fiber_free_tail = NULL;
+
+    return fiber;
+}
+
+/**
+ * @name   fiber_free(Fiber *fiber)
+ * 
+ * @brief  Devolve o cabeçalho da fiber para o fim da lista de livres.
+*/
+void fiber_free(Fiber *fiber)
+{
+    fiber->next = NULL;
+    if (fiber_free_tail != NULL)
+        fiber_free_tail->next = fiber;
+    else
+        fiber_free_list = fiber;
+    fiber_free_tail = fiber;
 }
 
 /**
  * @name   pop(Fiber *fiber)
  * 
- * @brief  Libera a memória da fiber e remove ela da lista.
+ * @brief  Libera a memória da fiber e remove ela da lista em tempo constante.
  * 
  * @param fiber - fiber que será desalocada.
  * 
@@ -224,15 +897,11 @@ Fiber *pop(Fiber *fiber)
     if (fiber->status != STATE_FINISHED)
         return NULL;
 
-    Fiber *prev_fiber = fiber_list->head;
+    Fiber *prev_fiber = fiber->prev;
     Fiber *next_fiber = fiber->next;
 
-    while (fiber != prev_fiber->next)
-    {
-        prev_fiber = prev_fiber->next;
-    }
-
-    prev_fiber->next = fiber->next;
+    prev_fiber->next = next_fiber;
+    next_fiber->prev = prev_fiber;
 
     if (fiber == fiber_list->head)
         fiber_list->head = fiber->next;
@@ -240,8 +909,12 @@ Fiber *pop(Fiber *fiber)
     if (fiber == fiber_list->tail)
         fiber_list->tail = prev_fiber;
 
-    free(fiber->context.uc_stack.ss_sp);
-    free(fiber);
+    // A Fiber_Cold fica no mesmo bloco da pilha, exceto na fiber principal
+    if (fiber->cold->context.uc_stack.ss_sp != NULL)
+        free(fiber->cold->context.uc_stack.ss_sp);
+    else
+        free(fiber->cold);
+    fiber_free(fiber);
     fiber = NULL;
 
     fiber_list->size--;
@@ -255,382 +928,2482 @@ Fiber *pop(Fiber *fiber)
     return next_fiber;
 }
 
+// Heap mínimo das fibers dormindo, ordenado pelo wake_at
+Fiber **sleep_heap = NULL;
+int sleep_heap_size = 0;
+int sleep_heap_capacity = 0;
+
+// Instante a partir do qual os descritores podem ser consultados de novo
+unsigned long long io_poll_at = 0;
+
 /**
- * @name   scheduler()
+ * @struct Fd_Waiters
+ * 
+ * @brief  Fibers esperando um descritor. O descritor é registrado uma única vez na
+ * epoll, com a união dos eventos esperados por elas.
  * 
- * @brief  Função responsável por fazer a preempção das fibers, para implementar  o
- * algoritmo round robin  a  estrutura de lista e fiber  tem o comportamento de uma 
- * lista circular. Essa função verifica  o estado da fiber e  age de acordo. Caso o
- * estado da fiber  seja STATE_READY, seu  contexto será setado como  o contexto de 
- * execução. Quando a lista estiver vazia suas estruturas serão desalocadas.
+ * @param head      fibers esperando o descritor, encadeadas pelo io_next.
+ * @param events    eventos registrados na epoll; 0 se o descritor não está nela.
 */
-void scheduler()
+typedef struct Fd_Waiters
 {
-    stop_timer();
+    Fiber *head; // fibers esperando o descritor
+    int events;  // eventos registrados na epoll
+} Fd_Waiters;
 
-    Fiber *nextFiber = fiber_list->running->next;
+// Fibers esperando cada descritor, indexadas pelo descritor
+Fd_Waiters *fd_waiters = NULL;
+int fd_waiters_size = 0;
 
-    // Enquanto não encontrar uma fiber pronta para ser executada
-    while (nextFiber->status != STATE_READY)
-    {
-        // Caso a fiber já tenha terminado
-        if (nextFiber->status == STATE_FINISHED)
-        {
-            // Liberando as head esperando esta(caso existam)
-            release_fibers(nextFiber->waitList);
-            // Destruindo essa fiber e obtendo a próxima(caso exista)
-            nextFiber = pop(nextFiber);
-            // Se a pop retornar NULL
-            if (nextFiber == NULL)
-            {
-                // Caso não haja mais nenhuma fiber na lista
-                if (fiber_list->size == 0)
-                {
-                    free(fiber_list);                   // Liberando a lista de head
-                    free(scheduler_ctx.uc_stack.ss_sp); // Liberando a pilha do escalonador
-                    exit(0);                            // Terminando o programa
-                }
-                // Caso contrário, algum erro ocorreu
-                exit(-1);
-            }
-        }
-        // Caso a thread atual esteja num join
-        if (nextFiber->status == STATE_BLOCKED)
-        {
-            // Caso a thread que ela está esperando não estiver encerrada
-            if (nextFiber->joinFiber->status != STATE_FINISHED)
-                nextFiber = nextFiber->next; // Pula a thread que está esperando
-            // Caso a thread que ela está esperando tenha terminado
-            else
-                nextFiber->status = STATE_READY; // Definir o status como STATE_READY
-        }
-    }
-
-    // Definindo a próxima fiber selecionada como a fiber atual
-    fiber_list->running = nextFiber;
+// Quantidade de fibers esperando descritores e bloqueadas na fiber_park
+int io_waiters = 0;
+int parked_fibers = 0;
 
-    // Redefinindo o timer para o tempo normal
-    timer.it_value.tv_sec = TIME_SLICE_SEC;
-    timer.it_value.tv_usec = TIME_SLICE_USEC;
+// Pilha lock-free das fibers acordadas pela fiber_unpark, inclusive de outras threads
+Fiber *remote_head = NULL;
 
-    start_timer();
+// epoll onde o escalonador dorme quando não há fibers prontas e o eventfd que o acorda
+int idle_epfd = -1;
+int idle_eventfd = -1;
 
-    // Definindo o contexto atual como o da próxima fiber
-    if (setcontext(&nextFiber->context) == -1)
-    {
-        perror("setcontext failed at scheduler");
-        return;
-    }
+/**
+ * @name   timer_place(Fiber *fiber, int index)
+ * 
+ * @brief  Coloca a fiber na posição index do heap de timers.
+*/
+void timer_place(Fiber *fiber, int index)
+{
+    sleep_heap[index] = fiber;
+    fiber->timer_index = index;
 }
 
 /**
- * @name   init_fiber_list()
- * 
- * @brief  Inicialzia a lista de fibers. Insere a estrutura da  thread principal na
- * lista. Inicializa o contexto do escalonador.
+ * @name   timer_up(int index)
  * 
+ * @brief  Sobe a fiber na posição index enquanto ela acordar antes do seu pai.
 */
-int init_fiber_list()
+void timer_up(int index)
 {
-    fiber_list = malloc(sizeof(Fiber_List)); // alocação da lista de fibers.
+    Fiber *fiber = sleep_heap[index];
 
-    if (fiber_list == NULL)
-    {
-        perror("list malloc failed at init_fiber_list.");
-        return -1;
-    }
-
-    Fiber *parentFiber = malloc(sizeof(Fiber));
-    if (parentFiber == NULL)
+    while (index > 0)
     {
-        perror("malloc failed at init_fiber_list.");
-        return -1;
+        int parent = (index - 1) / 2;
+        if (sleep_heap[parent]->wake_at <= fiber->wake_at)
+            break;
+        timer_place(sleep_heap[parent], index);
+        index = parent;
     }
 
-    parentFiber->context = parent_ctx;
-    parentFiber->next = parentFiber;
-    parentFiber->status = STATE_READY;
+    timer_place(fiber, index);
+}
 
-    fiber_list->head = parentFiber;
-    fiber_list->tail = parentFiber;
-    fiber_list->size = 1;
-    fiber_list->running = parentFiber;
+/**
+ * @name   timer_down(int index)
+ * 
+ * @brief  Desce a fiber na posição index enquanto algum filho acordar antes dela.
+*/
+void timer_down(int index)
+{
+    Fiber *fiber = sleep_heap[index];
 
-    if (getcontext(&scheduler_ctx) == -1)
+    for (;;)
     {
-        perror("getcontext failed at init_fiber_list.");
-        return -1;
+        int child = 2 * index + 1;
+        if (child >= sleep_heap_size)
+            break;
+        if (child + 1 < sleep_heap_size && sleep_heap[child + 1]->wake_at < sleep_heap[child]->wake_at)
+            child++;
+        if (fiber->wake_at <= sleep_heap[child]->wake_at)
+            break;
+        timer_place(sleep_heap[child], index);
+        index = child;
     }
 
-    scheduler_ctx.uc_link = &parent_ctx;
-    scheduler_ctx.uc_stack.ss_sp = malloc(FIBER_STACK_SIZE);
-    scheduler_ctx.uc_stack.ss_size = FIBER_STACK_SIZE;
-    scheduler_ctx.uc_stack.ss_flags = 0;
-    if (scheduler_ctx.uc_stack.ss_sp == NULL)
+    timer_place(fiber, index);
+}
+
+/**
+ * @name   timer_insert(Fiber *fiber)
+ * 
+ * @brief  Insere a fiber no heap de fibers dormindo, em O(log n).
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int timer_insert(Fiber *fiber)
+{
+    if (sleep_heap_size == sleep_heap_capacity)
     {
-        perror("stack malloc failed at init_fiber_list.");
-        return -1;
+        int capacity = sleep_heap_capacity ? 2 * sleep_heap_capacity : FIBER_SLAB_SIZE;
+        Fiber **heap = realloc(sleep_heap, capacity * sizeof(Fiber *));
+        if (heap == NULL)
+        {
+            perror("realloc failed at timer_insert.");
+            return -1;
+        }
+        sleep_heap = heap;
+        sleep_heap_capacity = capacity;
     }
 
-    makecontext(&scheduler_ctx, scheduler, 0);
+    sleep_heap[sleep_heap_size++] = fiber;
+    timer_up(sleep_heap_size - 1);
 
     return 0;
 }
 
 /**
- * @name   push(Fiber *fiber)
- * 
- * @brief  Insere a fiber no final da lista de fibers. Caso a lista seja nula chama
- * a função init_fiber_list().
+ * @name   timer_remove(Fiber *fiber)
  * 
- * @param  fiber ponteiro para fiber que será inserida.
+ * @brief  Retira a fiber do heap de fibers dormindo, em O(log n).
 */
-void push(Fiber *fiber)
+void timer_remove(Fiber *fiber)
 {
-    if (fiber_list == NULL)
-        init_fiber_list();
+    int index = fiber->timer_index;
+    Fiber *last = sleep_heap[--sleep_heap_size];
 
-    fiber->next = fiber_list->head;
-    fiber_list->tail->next = fiber;
-    fiber_list->tail = fiber;
-    fiber_list->size++;
+    // A última fiber ocupa a posição liberada e é reposicionada
+    if (last != fiber)
+    {
+        timer_place(last, index);
+        if (index > 0 && sleep_heap[(index - 1) / 2]->wake_at > last->wake_at)
+            timer_up(index);
+        else
+            timer_down(index);
+    }
+
+    fiber->timer_index = -1;
+    fiber->wake_at = 0;
 }
 
 /**
- * @name   init_fiber_attr(Fiber *new_node)
+ * @name   idle_timeout()
  * 
- * @brief  Inicializa as variáveis da fiber.
+ * @brief  Calcula quanto o escalonador pode dormir: até o próximo timer, ou sem
+ * limite caso nenhuma fiber esteja dormindo.
  * 
- * @param  new_node ponteiro para fiber para inicializiar seus valores.
+ * @return timeout em milisegundos para a epoll_wait.
 */
-void init_fiber_attr(Fiber *new_node)
+int idle_timeout()
 {
-    new_node->next = NULL;
-    new_node->status = STATE_READY;
-    new_node->retval = NULL;
-    new_node->join_rval = NULL;
-    new_node->joinFiber = NULL;
-    new_node->waitList = NULL;
+    if (sleep_heap_size == 0)
+        return -1;
+
+    unsigned long long now = trace_now_ns();
+    if (sleep_heap[0]->wake_at <= now)
+        return 0;
+
+    // Arredonda para cima para não acordar antes do timer
+    return (sleep_heap[0]->wake_at - now + 999999) / 1000000;
 }
 
 /**
- * @name   fiber_create(fiber_t *fiber, void *(*start_routine)(void *), void *arg)
- * 
- * @brief  Cria uma fiber (thread no user-space).
+ * @name   fd_update(int fd)
  * 
- * @param  fiber identificador que será retornado por referência.
- * @param  start_routine rotina que será executada.
- * @param  arg argumento que será passados para a rotina.
+ * @brief  Registra na epoll a união dos eventos esperados pelas fibers do
+ * descritor, retirando-o quando não houver mais nenhuma.
  * 
  * @return 0 para sucesso; -1 para falha.
 */
-int fiber_create(fiber_t *fiber, void *(*start_routine)(void *), void *arg)
+int fd_update(int fd)
 {
-    stop_timer();
+    Fd_Waiters *waiters = &fd_waiters[fd];
+    int events = 0;
 
-    ucontext_t context;
+    for (Fiber *fiber = waiters->head; fiber != NULL; fiber = fiber->cold->io_next)
+        events |= fiber->cold->io_wait;
 
-    Fiber *new_node;
+    if (events == waiters->events)
+        return 0;
 
-    if (fiber == NULL)
-        return -1;
+    struct epoll_event event;
+    event.events = events;
+    event.data.fd = fd;
 
-    new_node = (Fiber *)malloc(sizeof(Fiber));
+    int op = EPOLL_CTL_MOD;
+    if (waiters->events == 0)
+        op = EPOLL_CTL_ADD;
+    else if (events == 0)
+        op = EPOLL_CTL_DEL;
 
-    if (new_node == NULL)
+    // O descritor pode ter sido fechado, o que o retira da epoll sozinho
+    if (epoll_ctl(idle_epfd, op, fd, &event) == -1 && !(op != EPOLL_CTL_ADD && errno == ENOENT))
     {
-        perror("malloc failed at fiber_create.");
+        perror("epoll_ctl failed at fd_update.");
         return -1;
     }
 
-    /*
-     * A função getcontext(ucontext_t *ucp) inicializa a estrutura apontada por ucp 
-     * para o contexto atual da thread que fez a chamada. O tipo  ucontext_t para o 
-     * qual ucp aponta define o  contexto do  usuário e inclui o  conteúdo do atual 
-     * contexto de  execução como  registradores,  a  máscara de sinal e a pilha de 
-     * execução atual. 
-    */
+    waiters->events = events;
 
-    if (getcontext(&context) == -1)
-    {
-        perror("getcontext failed at fiber_create");
-        return -1;
-    }
+    return 0;
+}
 
-    /*
-     * ucontext_t * uc_link ponteiro para o contexto que será retomado  quando este
-     * contexto retornar;
-     * O cabeçalho <signal.h> define o tipo stack_t como uma  estrutura que  inclui 
-     * pelo menos os seguintes membros:
-    */
+/**
+ * @name   fd_unlink(Fiber *fiber)
+ * 
+ * @brief  Retira a fiber da lista do descritor que ela espera.
+*/
+void fd_unlink(Fiber *fiber)
+{
+    Fiber **link = &fd_waiters[fiber->cold->waitFd].head;
 
-    context.uc_link = &scheduler_ctx;
-    context.uc_stack.ss_sp = malloc(FIBER_STACK_SIZE);
-    context.uc_stack.ss_size = FIBER_STACK_SIZE;
-    context.uc_stack.ss_flags = 0;
+    while (*link != fiber)
+        link = &(*link)->cold->io_next;
+    *link = fiber->cold->io_next;
 
-    if (context.uc_stack.ss_sp == 0)
+    fiber->cold->io_next = NULL;
+    fiber->cold->waitFd = -1;
+    io_waiters--;
+}
+
+/**
+ * @name   idle_poll(int timeout)
+ * 
+ * @brief  Acorda as fibers cujos descritores ficaram prontos, cujos timers
+ * expiraram ou que receberam fiber_unpark. Caso timeout não seja zero o
+ * escalonador dorme na epoll_wait até algum desses eventos acontecer; caso
+ * contrário os descritores são consultados no máximo uma vez por time slice,
+ * para que as trocas de contexto não paguem uma chamada de sistema cada.
+ * 
+ * @param  timeout tempo máximo de espera em milisegundos; -1 sem limite.
+*/
+void idle_poll(int timeout)
+{
+    unsigned long long now = trace_now_ns();
+
+    if (timeout != 0 || (io_waiters > 0 && now >= io_poll_at))
     {
-        perror("stack malloc failed at fiber_create.");
-        return -1;
-    }
+        struct epoll_event events[IDLE_MAX_EVENTS];
 
-    /*
-     * A função makecontext(ucontext_t *ucp, (void *func)(), int argc, ..) modifica
-     * o contexto especificado por ucp,  que foi  inicializado usando getcontext().
-     * Quando  este  contexto é  retomado  usando  swapcontext()  ou  setcontext(), 
-     * a execução  do  programa  continua chamando func, passando os argumentos que
-     * seguem argc na chamada da makecontext().
-    */
+        int n = epoll_wait(idle_epfd, events, IDLE_MAX_EVENTS, timeout);
+        if (n == -1 && errno != EINTR)
+            perror("epoll_wait failed at idle_poll.");
 
-    makecontext(&context, (void (*)(void))start_routine, 1, arg);
+        if (timeout != 0)
+            now = trace_now_ns();
+        io_poll_at = now + IDLE_IO_INTERVAL_NS;
 
-    new_node->context = context;
-    init_fiber_attr(new_node);
+        for (int i = 0; i < n; i++)
+        {
+            int fd = events[i].data.fd;
 
-    push(new_node);
+            // Despertar remoto; a pilha é esvaziada abaixo
+            if (fd == idle_eventfd)
+            {
+                uint64_t count;
+                if (read(idle_eventfd, &count, sizeof(count)) == -1 && errno != EAGAIN)
+                    perror("read failed at idle_poll.");
+                continue;
+            }
 
-    *fiber = new_node;
+            // Acorda as fibers interessadas nos eventos recebidos; erros acordam todas
+            Fiber *fiber = fd_waiters[fd].head;
+            while (fiber != NULL)
+            {
+                Fiber *next = fiber->cold->io_next;
+                if (events[i].events & (fiber->cold->io_wait | EPOLLERR | EPOLLHUP))
+                {
+                    fd_unlink(fiber);
+                    fiber->cold->io_events = events[i].events;
+                    sched_wake(fiber);
+                }
+                fiber = next;
+            }
 
-    start_timer();
+            fd_update(fd);
+        }
+    }
 
-    return 0;
+    // Fibers que receberam fiber_unpark
+    Fiber *fiber = __atomic_exchange_n(&remote_head, NULL, __ATOMIC_ACQUIRE);
+    while (fiber != NULL)
+    {
+        Fiber *next = fiber->cold->remote_next;
+        __atomic_store_n(&fiber->cold->remote_queued, 0, __ATOMIC_SEQ_CST);
+
+        if (fiber->cold->parked && __atomic_exchange_n(&fiber->cold->permit, 0, __ATOMIC_SEQ_CST))
+        {
+            fiber->cold->parked = 0;
+            parked_fibers--;
+            sched_wake(fiber);
+        }
+
+        fiber = next;
+    }
+
+    // Timers expirados
+    while (sleep_heap_size > 0 && sleep_heap[0]->wake_at <= now)
+    {
+        fiber = sleep_heap[0];
+        timer_remove(fiber);
+        sched_wake(fiber);
+    }
 }
 
 /**
- * @name   fiber_join(fiber_t fiber, void **retval)
- * 
- * @brief  Coloca a fiber  atual em espera  para execução até o fim de outra fiber.
- * 
- * @param  retval endereço para onde será colocado o valor de retorno  da  fiber.
- * Caso seja nulo será ignorado.
+ * @name   init_idle()
  * 
- * @return 0 para sucesso; -1 para falha.
+ * @brief  Cria a epoll e o eventfd usados para dormir quando não há fibers prontas.
 */
-int fiber_join(fiber_t fiber, void **retval)
+void init_idle()
 {
+    idle_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (idle_epfd == -1)
+    {
+        perror("epoll_create1 failed at init_idle.");
+        return;
+    }
 
-    int i = 0;
-
-    Fiber *fiber_node = NULL;
-    for (fiber_node = fiber_list->head; fiber != fiber_node && ++i <= fiber_list->size; fiber_node = fiber_node->next);
+    idle_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (idle_eventfd == -1)
+    {
+        perror("eventfd failed at init_idle.");
+        return;
+    }
 
-    if (i > fiber_list->size)
-        return -1;
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = idle_eventfd;
 
-    // Se a fiber a ser esperada é a que está executando
-    if (fiber_node == fiber_list->running)
-        return -1;
+    if (epoll_ctl(idle_epfd, EPOLL_CTL_ADD, idle_eventfd, &event) == -1)
+        perror("epoll_ctl failed at init_idle.");
+}
 
-    // Se a fiber que deveria terminar antes já terminou
-    if (fiber_node->status == STATE_FINISHED)
+/**
+ * @name   group_free(Fiber_Group *group)
+ * 
+ * @brief  Desaloca o grupo e os resultados não consumidos.
+*/
+void group_free(Fiber_Group *group)
+{
+    while (group->head != NULL)
     {
-        release_fibers(fiber_node->waitList);
-        return 0;
+        Group_Result *next = group->head->next;
+        free(group->head);
+        group->head = next;
     }
 
-    Waiting *waitingNode = malloc(sizeof(Waiting));
+    free(group);
+}
 
-    if (waitingNode == NULL)
-    {
-        perror("malloc failed at fiber_join.");
-        return -1;
-    }
+/**
+ * @name   group_child_finished(Fiber *fiber)
+ * 
+ * @brief  Retira a fiber finalizada do seu grupo e guarda seu resultado. Acorda o
+ * waiter do grupo uma única vez: no primeiro término, para a wait_any, ou no
+ * término da última filha, para a join_all.
+ * 
+ * @param  fiber fiber finalizada.
+*/
+void group_child_finished(Fiber *fiber)
+{
+    Fiber_Group *group = fiber->cold->group;
 
-    // Atribuindo o id do nodo e inicializando seu ponteiro next+-
-    waitingNode->id = fiber;
-    waitingNode->next = NULL;
+    if (fiber->cold->group_prev != NULL)
+        fiber->cold->group_prev->cold->group_next = fiber->cold->group_next;
+    else
+        group->children = fiber->cold->group_next;
+    if (fiber->cold->group_next != NULL)
+        fiber->cold->group_next->cold->group_prev = fiber->cold->group_prev;
 
-    // Parar o timer, área crítica
-    stop_timer(NULL);
+    // O resultado foi alocado na criação, para que o término nunca falhe
+    Group_Result *result = fiber->cold->group_result;
+    fiber->cold->group_result = NULL;
+    fiber->cold->group = NULL;
+    group->live--;
 
-    // Adicionando um nodo na lista de espera da fiber a ser aguardada
-    if (fiber_node->waitList == NULL)
+    if (group->destroyed)
     {
-        fiber_node->waitList = (Waiting *)waitingNode;
+        free(result);
+        if (group->live == 0)
+            group_free(group);
+        return;
     }
+
+    result->fiber = fiber;
+    result->retval = fiber->cold->retval;
+    result->next = NULL;
+
+    if (group->tail == NULL)
+        group->head = result;
     else
+        group->tail->next = result;
+    group->tail = result;
+
+    if (group->waiter != NULL && (group->wait_any || group->live == 0))
     {
-        Waiting *waitingTop = (Waiting *)fiber_node->waitList;
-        fiber_node->waitList = (Waiting *)waitingNode;
-        fiber_node->waitList->next = (Waiting *)waitingTop;
+        Fiber *waiter = group->waiter;
+        group->waiter = NULL;
+        waiter->cold->waitGroup = NULL;
+        sched_wake(waiter);
     }
+}
 
-    // Definindo a fiber que a fiber atual está esperando
-    fiber_list->running->joinFiber = (Fiber *)fiber_node;
+/**
+ * @name   dump_backtrace(FILE *out, Fiber *fiber)
+ * 
+ * @brief  Escreve o backtrace de uma fiber que não está executando, percorrendo
+ * os frame pointers a partir do contexto salvo. Uma fiber preemptada é percorrida
+ * a partir do ponto interrompido pelo timer, e não do handler do sinal. Os quadros
+ * só são completos em código compilado com -fno-omit-frame-pointer.
+*/
+void dump_backtrace(FILE *out, Fiber *fiber)
+{
+#if defined(__x86_64__)
+    void *frames[DUMP_MAX_FRAMES];
+    int size = 0;
 
-    // Marcando a fiber atual como esperando
-    fiber_list->running->status = STATE_BLOCKED;
+    greg_t *gregs = fiber->cold->context.uc_mcontext.gregs;
+    uintptr_t pc = gregs[REG_RIP];
+    uintptr_t frame = gregs[REG_RBP];
+    uintptr_t low = gregs[REG_RSP];
 
-    // Trocando para o contexto do escalonador
-    if (swapcontext(&fiber_list->running->context, &scheduler_ctx) == -1)
+    if (fiber->cold->preempted)
     {
-        perror("swapcontext failed at fiber_join.");
-        return -1;
+        pc = fiber->cold->preempt_pc;
+        frame = fiber->cold->preempt_fp;
+        low = fiber->cold->preempt_sp;
     }
 
-    // Recuperando o valor de retorno da fiber que estava sendo aguardada.
-    // Caso NULL tenha sido passado como argumento para retval, nada mais é feito.
-    // Caso a fiber que estava sendo aguardada por esta tenha sido destruída,
-    // as rotinas de destruição já distribuíram os valores de retval corretamente
-    // para os atributos join_rval das head que estavam aguardando-a.
-    if (retval != NULL)
+    // Fibers criadas pela biblioteca têm a pilha conhecida; a principal usa a do processo
+    uintptr_t high = main_stack_high;
+    if (fiber->cold->context.uc_stack.ss_sp != NULL)
     {
-        // Caso a joinFiber não tenha sido destruída ainda, o retval é recuperado diretamente dela
-        if (fiber_list->running->join_rval == NULL && fiber_list->running->joinFiber != NULL)
-            *retval = fiber_list->running->joinFiber->retval;
-        // Caso contrário, o retval é recuperado do atributo join_rval da própria fiber que chamou
-        // fiber_join()
-        else
-            *retval = fiber_list->running->join_rval;
-
-        // Resetando os retvals da fiber
-        fiber_list->running->retval = NULL;
-        fiber_list->running->join_rval = NULL;
+        low = (uintptr_t)fiber->cold->context.uc_stack.ss_sp;
+        high = low + fiber->cold->context.uc_stack.ss_size;
     }
 
-    // Definindo o status da fiber atual como pronta para executar
-    fiber_list->running->status = STATE_READY;
+    frames[size++] = (void *)pc;
 
-    return 0;
+    // Cada quadro guarda o rbp anterior e o endereço de retorno logo acima
+    while (size < DUMP_MAX_FRAMES && frame >= low && frame + 2 * sizeof(void *) <= high && frame % sizeof(void *) == 0)
+    {
+        void **pair = (void **)frame;
+        if (pair[1] == NULL)
+            break;
+
+        frames[size++] = pair[1];
+
+        // A pilha cresce para baixo; o quadro anterior deve estar acima
+        if ((uintptr_t)pair[0] <= frame)
+            break;
+        frame = (uintptr_t)pair[0];
+    }
+
+    fflush(out);
+    backtrace_symbols_fd(frames, size, fileno(out));
+#else
+    fprintf(out, "  backtrace unavailable on this architecture\n");
+#endif
 }
 
 /**
- * @name   fiber_destory(fiber_t fiber)
+ * @name   dump_fibers(FILE *out, Fiber *live)
  * 
- * @brief  Desaloca a fiber.
- * 
- * @param  fiber - identificador da fiber que deve ser desalocada.
+ * @brief  Escreve o id, o estado, o que cada fiber está esperando, o tempo em
+ * execução e o backtrace de todas as fibers da lista. Deve ser chamada com o
+ * timer parado.
+ * 
+ * @param  out arquivo de saída.
+ * @param  live fiber que está executando esta função, cujo contexto salvo está
+ * desatualizado; NULL quando chamada pelo escalonador.
+*/
+void dump_fibers(FILE *out, Fiber *live)
+{
+    static const char *states[] = {"ready", "blocked", "finished"};
+
+    unsigned long long now = trace_now_ns();
+    Fiber *fiber = fiber_list->head;
+
+    fprintf(out, "fibers: %d, policy %s\n", fiber_list->size, sched_policy->name);
+
+    for (int i = 0; i < fiber_list->size; i++, fiber = fiber->next)
+    {
+        Fiber_Cold *cold = fiber->cold;
+        unsigned long long run_ns = cold->run_ns;
+
+        if (fiber == live)
+            run_ns += now - run_start;
+
+        fprintf(out, "fiber %lu [%s]", cold->id, fiber == live ? "running" : states[fiber->status]);
+
+        if (cold->joinFiber != NULL)
+            fprintf(out, " join fiber %lu", cold->joinFiber->cold->id);
+        if (cold->waitGroup != NULL)
+            fprintf(out, " group %p", (void *)cold->waitGroup);
+        if (cold->waitFuture != NULL)
+            fprintf(out, " future %p", (void *)cold->waitFuture);
+        if (cold->waitFd != -1)
+            fprintf(out, " fd %d", cold->waitFd);
+        if (fiber->wake_at != 0)
+            fprintf(out, " timer %.3f ms", fiber->wake_at > now ? (fiber->wake_at - now) / 1e6 : 0.0);
+        if (cold->parked)
+            fprintf(out, " park");
+        if (cold->cancel)
+            fprintf(out, " cancel pending");
+
+        fprintf(out, ", ran %.3f ms, routine %p\n", run_ns / 1e6, (void *)cold->routine);
+
+        if (fiber == live && !cold->preempted)
+        {
+            void *frames[DUMP_MAX_FRAMES];
+            int size = backtrace(frames, DUMP_MAX_FRAMES);
+
+            fflush(out);
+            backtrace_symbols_fd(frames, size, fileno(out));
+        }
+        else if (fiber->status != STATE_FINISHED)
+        {
+            dump_backtrace(out, fiber);
+        }
+    }
+
+    fflush(out);
+}
+
+/**
+ * @name   scheduler()
+ * 
+ * @brief  Função responsável por fazer a preempção das fibers. Devolve a fiber que
+ * saiu da CPU para a política de escalonamento de acordo com seu estado e executa
+ * a fiber escolhida pelo pick_next da política. Fibers finalizadas são removidas
+ * da lista e, quando a lista estiver vazia, suas estruturas serão desalocadas.
+*/
+void scheduler()
+{
+    stop_timer();
+
+    Fiber *current = fiber_list->running;
+
+    // O tempo no escalonador, inclusive dormindo na epoll_wait, não é de nenhuma fiber
+    unsigned long long now = trace_now_ns();
+    current->cold->run_ns += now - run_start;
+    run_start = now;
+
+    // Retrato pedido pelo sinal da fiber_dump_on_signal()
+    if (__builtin_expect(dump_requested, 0))
+    {
+        dump_requested = 0;
+        dump_fibers(stderr, NULL);
+    }
+
+    // Preemptada: volta para a fila de prontos
+    if (current->status == STATE_READY)
+    {
+        sched_policy->enqueue(current);
+    }
+    // Em espera: a fila de prontos só a recebe de volta pela sched_wake()
+    else if (current->status == STATE_BLOCKED)
+    {
+        if (sched_policy->on_block != NULL)
+            sched_policy->on_block(current);
+    }
+    // Finalizada: libera as fibers esperando esta e a destrói. Se ninguém a esperava,
+    // fica na lista até a fiber_join ou a fiber_destroy recolher o retval
+    else if (current->status == STATE_FINISHED)
+    {
+        // Mede a pilha já no término, pois a fiber pode nunca ser desalocada
+        if (__builtin_expect(current->cold->stack_painted, 0))
+            stack_profile_record(current);
+
+        int joined = release_fibers(current->cold->waitList);
+        current->cold->waitList = NULL;
+
+        // Filhas de grupo têm o retval guardado pelo grupo e são sempre desalocadas
+        int reap = joined > 0 || current->cold->detached || current->cold->group != NULL;
+
+        if (current->cold->group != NULL)
+            group_child_finished(current);
+        fiber_list->running = NULL;
+
+        if (reap)
+        {
+            if (pop(current) == NULL && fiber_list->size != 0)
+                exit(-1); // algum erro ocorreu
+        }
+        else
+            fiber_list->zombies++;
+
+        // Caso só restem fibers finalizadas na lista
+        if (fiber_list->size == fiber_list->zombies)
+        {
+            free(fiber_list);                   // Liberando a lista de head
+            free(scheduler_ctx.uc_stack.ss_sp); // Liberando a pilha do escalonador
+            exit(0);                            // Terminando o programa
+        }
+    }
+
+    // Acorda as fibers esperando descritores, timers ou fiber_unpark
+    if (__builtin_expect(io_waiters > 0 || sleep_heap_size > 0 ||
+                             __atomic_load_n(&remote_head, __ATOMIC_RELAXED) != NULL,
+                         0))
+        idle_poll(0);
+
+    Fiber *nextFiber;
+
+    // Enquanto não houver fiber pronta, dorme até a próxima fiber ser acordada
+    while ((nextFiber = sched_policy->pick_next()) == NULL)
+    {
+        // Todas as fibers estão em espera e nenhuma pode ser liberada
+        if (io_waiters == 0 && sleep_heap_size == 0 && parked_fibers == 0 &&
+            __atomic_load_n(&remote_head, __ATOMIC_RELAXED) == NULL)
+        {
+            fprintf(stderr, "deadlock: every fiber is blocked.\n");
+            dump_fibers(stderr, NULL);
+            exit(-1);
+        }
+
+        idle_poll(idle_timeout());
+
+        // O sinal da fiber_dump_on_signal() interrompe a epoll_wait
+        if (dump_requested)
+        {
+            dump_requested = 0;
+            dump_fibers(stderr, NULL);
+        }
+    }
+
+    // Definindo a próxima fiber selecionada como a fiber atual
+    fiber_list->running = nextFiber;
+
+    TRACE(TRACE_RUN, nextFiber);
+
+    run_start = trace_now_ns();
+
+    // Redefinindo o timer para o tempo normal
+    timer.it_value.tv_sec = TIME_SLICE_SEC;
+    timer.it_value.tv_usec = TIME_SLICE_USEC;
+
+    start_timer();
+
+    // Definindo o contexto atual como o da próxima fiber
+    if (setcontext(&nextFiber->cold->context) == -1)
+    {
+        perror("setcontext failed at scheduler");
+        return;
+    }
+}
+
+/**
+ * @name   init_fiber_attr(Fiber *new_node)
+ * 
+ * @brief  Inicializa as variáveis da fiber.
+ * 
+ * @param  new_node ponteiro para fiber para inicializiar seus valores.
+*/
+void init_fiber_attr(Fiber *new_node)
+{
+    new_node->next = NULL;
+    new_node->prev = NULL;
+    new_node->cold->id = fiber_next_id++;
+    new_node->status = STATE_READY;
+    new_node->cold->retval = NULL;
+    new_node->cold->join_rval = NULL;
+    new_node->cold->joinFiber = NULL;
+    new_node->cold->waitList = NULL;
+    new_node->cold->start_routine = NULL;
+    new_node->cold->arg = NULL;
+    new_node->cold->routine = NULL;
+    new_node->rq_next = NULL;
+    new_node->priority = 0;
+    new_node->deadline = 0;
+    new_node->cold->sched_data = NULL;
+    new_node->cold->cancel = 0;
+    new_node->cold->waitNode = NULL;
+    new_node->cold->cleanup = NULL;
+    new_node->cold->stack_painted = 0;
+    new_node->cold->group = NULL;
+    new_node->cold->group_prev = NULL;
+    new_node->cold->group_next = NULL;
+    new_node->cold->group_result = NULL;
+    new_node->cold->waitGroup = NULL;
+    new_node->cold->waitFuture = NULL;
+    new_node->wake_at = 0;
+    new_node->timer_index = -1;
+    new_node->cold->waitFd = -1;
+    new_node->cold->io_events = 0;
+    new_node->cold->io_wait = 0;
+    new_node->cold->io_next = NULL;
+    new_node->cold->parked = 0;
+    new_node->cold->permit = 0;
+    new_node->cold->remote_queued = 0;
+    new_node->cold->remote_next = NULL;
+    new_node->cold->run_ns = 0;
+    new_node->cold->detached = 0;
+    new_node->cold->preempted = 0;
+}
+
+/**
+ * @name   init_fiber_list()
+ * 
+ * @brief  Inicialzia a lista de fibers. Insere a estrutura da  thread principal na
+ * lista. Inicializa o contexto do escalonador.
+ * 
+*/
+int init_fiber_list()
+{
+    fiber_list = malloc(sizeof(Fiber_List)); // alocação da lista de fibers.
+
+    if (fiber_list == NULL)
+    {
+        perror("list malloc failed at init_fiber_list.");
+        return -1;
+    }
+
+    Fiber *parentFiber = fiber_alloc();
+    if (parentFiber == NULL)
+    {
+        perror("malloc failed at init_fiber_list.");
+        return -1;
+    }
+
+    // A fiber principal usa a pilha do processo; só a Fiber_Cold é alocada
+    parentFiber->cold = malloc(sizeof(Fiber_Cold));
+    if (parentFiber->cold == NULL)
+    {
+        perror("malloc failed at init_fiber_list.");
+        return -1;
+    }
+
+    init_fiber_attr(parentFiber);
+    parentFiber->cold->context = parent_ctx;
+    parentFiber->next = parentFiber;
+    parentFiber->prev = parentFiber;
+
+    fiber_list->head = parentFiber;
+    fiber_list->tail = parentFiber;
+    fiber_list->size = 1;
+    fiber_list->zombies = 0;
+    fiber_list->running = parentFiber;
+    run_start = trace_now_ns();
+
+    // Limites reais da pilha do processo, para percorrer os quadros da fiber principal
+    pthread_attr_t attr;
+    void *stack_addr;
+    size_t stack_size;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0)
+    {
+        if (pthread_attr_getstack(&attr, &stack_addr, &stack_size) == 0)
+            main_stack_high = (uintptr_t)stack_addr + stack_size;
+        pthread_attr_destroy(&attr);
+    }
+
+    if (getcontext(&scheduler_ctx) == -1)
+    {
+        perror("getcontext failed at init_fiber_list.");
+        return -1;
+    }
+
+    scheduler_ctx.uc_link = &parent_ctx;
+    scheduler_ctx.uc_stack.ss_sp = malloc(FIBER_STACK_SIZE);
+    scheduler_ctx.uc_stack.ss_size = FIBER_STACK_SIZE;
+    scheduler_ctx.uc_stack.ss_flags = 0;
+    if (scheduler_ctx.uc_stack.ss_sp == NULL)
+    {
+        perror("stack malloc failed at init_fiber_list.");
+        return -1;
+    }
+
+    makecontext(&scheduler_ctx, scheduler, 0);
+
+    return 0;
+}
+
+/**
+ * @name   push(Fiber *fiber)
+ * 
+ * @brief  Insere a fiber no final da lista de fibers. Caso a lista seja nula chama
+ * a função init_fiber_list().
+ * 
+ * @param  fiber ponteiro para fiber que será inserida.
+*/
+void push(Fiber *fiber)
+{
+    if (fiber_list == NULL)
+        init_fiber_list();
+
+    fiber->next = fiber_list->head;
+    fiber->prev = fiber_list->tail;
+    fiber_list->tail->next = fiber;
+    fiber_list->head->prev = fiber;
+    fiber_list->tail = fiber;
+    fiber_list->size++;
+}
+
+/**
+ * @name   fiber_start()
+ * 
+ * @brief  Ponto de entrada das fibers. Executa a rotina da fiber e a finaliza com
+ * o valor retornado, de modo que retornar da rotina equivale a chamar fiber_exit().
+*/
+void fiber_start()
+{
+    Fiber *self = fiber_list->running;
+
+    fiber_exit(self->cold->start_routine(self->cold->arg));
+}
+
+// Rotina do usuário por trás das rotinas internas, definida abaixo
+void *(*fiber_routine(void *(*start_routine)(void *), void *arg))(void *);
+
+/**
+ * @name   create_fiber(fiber_t *fiber, void *(*start_routine)(void *), void *arg, Fiber_Group *group, Group_Result *result, int detached)
+ * 
+ * @brief  Cria uma fiber (thread no user-space), opcionalmente como filha de um
+ * grupo. A fiber entra no grupo antes de poder executar.
+ * 
+ * @param  fiber identificador que será retornado por referência.
+ * @param  start_routine rotina que será executada.
+ * @param  arg argumento que será passados para a rotina.
+ * @param  group grupo da fiber; NULL para nenhum.
+ * @param  result resultado reservado para o grupo; NULL se não houver grupo.
+ * @param  detached 1 para desalocar a fiber ao terminar, sem fiber_join.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int create_fiber(fiber_t *fiber, void *(*start_routine)(void *), void *arg, Fiber_Group *group, Group_Result *result, int detached)
+{
+    stop_timer();
+
+    ucontext_t context;
+
+    Fiber *new_node;
+
+    if (fiber == NULL)
+        return -1;
+
+    new_node = fiber_alloc();
+
+    if (new_node == NULL)
+    {
+        perror("malloc failed at fiber_create.");
+        return -1;
+    }
+
+    /*
+     * A função getcontext(ucontext_t *ucp) inicializa a estrutura apontada por ucp 
+     * para o contexto atual da thread que fez a chamada. O tipo  ucontext_t para o 
+     * qual ucp aponta define o  contexto do  usuário e inclui o  conteúdo do atual 
+     * contexto de  execução como  registradores,  a  máscara de sinal e a pilha de 
+     * execução atual. 
+    */
+
+    if (getcontext(&context) == -1)
+    {
+        perror("getcontext failed at fiber_create");
+        return -1;
+    }
+
+    /*
+     * ucontext_t * uc_link ponteiro para o contexto que será retomado  quando este
+     * contexto retornar;
+     * O cabeçalho <signal.h> define o tipo stack_t como uma  estrutura que  inclui 
+     * pelo menos os seguintes membros:
+    */
+
+    context.uc_link = &scheduler_ctx;
+    context.uc_stack.ss_sp = malloc(FIBER_STACK_SIZE + sizeof(Fiber_Cold));
+    context.uc_stack.ss_size = FIBER_STACK_SIZE;
+    context.uc_stack.ss_flags = 0;
+
+    if (context.uc_stack.ss_sp == 0)
+    {
+        perror("stack malloc failed at fiber_create.");
+        return -1;
+    }
+
+    // A Fiber_Cold fica acima do topo da pilha, longe de onde um estouro escreve
+    new_node->cold = (Fiber_Cold *)((char *)context.uc_stack.ss_sp + FIBER_STACK_SIZE);
+
+    // Pinta a pilha para medir o uso máximo quando a fiber terminar
+    if (stack_profile_enabled)
+        memset(context.uc_stack.ss_sp, STACK_CANARY, FIBER_STACK_SIZE);
+
+    /*
+     * A função makecontext(ucontext_t *ucp, (void *func)(), int argc, ..) modifica
+     * o contexto especificado por ucp,  que foi  inicializado usando getcontext().
+     * Quando  este  contexto é  retomado  usando  swapcontext()  ou  setcontext(), 
+     * a execução  do  programa  continua chamando func, passando os argumentos que
+     * seguem argc na chamada da makecontext().
+    */
+
+    makecontext(&context, fiber_start, 0);
+
+    new_node->cold->context = context;
+    init_fiber_attr(new_node);
+    new_node->cold->start_routine = start_routine;
+    new_node->cold->arg = arg;
+    new_node->cold->routine = fiber_routine(start_routine, arg);
+    new_node->cold->stack_painted = stack_profile_enabled;
+    new_node->cold->detached = detached;
+
+    push(new_node);
+
+    if (group != NULL)
+    {
+        new_node->cold->group = group;
+        new_node->cold->group_result = result;
+        new_node->cold->group_next = group->children;
+        if (group->children != NULL)
+            group->children->cold->group_prev = new_node;
+        group->children = new_node;
+        group->live++;
+    }
+
+    TRACE(TRACE_CREATE, new_node);
+
+    sched_policy->enqueue(new_node);
+
+    *fiber = new_node;
+
+    start_timer();
+
+    return 0;
+}
+
+/**
+ * @name   fiber_create(fiber_t *fiber, void *(*start_routine)(void *), void *arg)
+ * 
+ * @brief  Cria uma fiber (thread no user-space).
+ * 
+ * @param  fiber identificador que será retornado por referência.
+ * @param  start_routine rotina que será executada.
+ * @param  arg argumento que será passados para a rotina.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_create(fiber_t *fiber, void *(*start_routine)(void *), void *arg)
+{
+    return create_fiber(fiber, start_routine, arg, NULL, NULL, 0);
+}
+
+/**
+ * @name   fiber_join(fiber_t fiber, void **retval)
+ * 
+ * @brief  Coloca a fiber  atual em espera  para execução até o fim de outra fiber.
+ * Se ela já terminou, retorna seu valor imediatamente e a desaloca.
+ * 
+ * @param  retval endereço para onde será colocado o valor de retorno  da  fiber.
+ * Caso seja nulo será ignorado.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_join(fiber_t fiber, void **retval)
+{
+    // Parar o timer, área crítica
+    stop_timer();
+
+    // Ponto de cancelamento
+    if (fiber_list->running->cold->cancel)
+    {
+        start_timer();
+        fiber_testcancel();
+    }
+
+    int i = 0;
+
+    Fiber *fiber_node = NULL;
+    for (fiber_node = fiber_list->head; fiber != fiber_node && ++i <= fiber_list->size; fiber_node = fiber_node->next);
+
+    // Se a fiber não existe ou é a que está executando
+    if (i > fiber_list->size || fiber_node == fiber_list->running)
+    {
+        start_timer();
+        return -1;
+    }
+
+    // Se a fiber que deveria terminar antes já terminou, recolhe o retval e a desaloca
+    if (fiber_node->status == STATE_FINISHED)
+    {
+        if (retval != NULL)
+            *retval = fiber_node->cold->retval;
+        fiber_list->zombies--;
+        pop(fiber_node);
+        start_timer();
+        return 0;
+    }
+
+    Waiting *waitingNode = malloc(sizeof(Waiting));
+
+    if (waitingNode == NULL)
+    {
+        perror("malloc failed at fiber_join.");
+        start_timer();
+        return -1;
+    }
+
+    // Atribuindo o id da fiber que espera e inicializando o ponteiro next
+    waitingNode->id = fiber_list->running;
+    waitingNode->next = NULL;
+
+    // Adicionando um nodo na lista de espera da fiber a ser aguardada
+    if (fiber_node->cold->waitList == NULL)
+    {
+        fiber_node->cold->waitList = (Waiting *)waitingNode;
+    }
+    else
+    {
+        Waiting *waitingTop = (Waiting *)fiber_node->cold->waitList;
+        fiber_node->cold->waitList = (Waiting *)waitingNode;
+        fiber_node->cold->waitList->next = (Waiting *)waitingTop;
+    }
+
+    // Definindo a fiber que a fiber atual está esperando
+    fiber_list->running->cold->joinFiber = (Fiber *)fiber_node;
+    fiber_list->running->cold->waitNode = waitingNode;
+
+    // Marcando a fiber atual como esperando
+    fiber_list->running->status = STATE_BLOCKED;
+
+    TRACE(TRACE_BLOCK, fiber_list->running);
+
+    // Trocando para o contexto do escalonador
+    if (swapcontext(&fiber_list->running->cold->context, &scheduler_ctx) == -1)
+    {
+        perror("swapcontext failed at fiber_join.");
+        return -1;
+    }
+
+    // Acordada pela fiber_cancel() antes do fim da joinFiber
+    fiber_testcancel();
+
+    // Recuperando o valor de retorno da fiber que estava sendo aguardada. A
+    // release_fibers() já o copiou para o join_rval antes de destruí-la.
+    // Caso NULL tenha sido passado como argumento para retval, nada mais é feito.
+    if (retval != NULL)
+        *retval = fiber_list->running->cold->join_rval;
+
+    // Resetando o retval da join
+    fiber_list->running->cold->join_rval = NULL;
+
+    // Definindo o status da fiber atual como pronta para executar
+    fiber_list->running->status = STATE_READY;
+
+    return 0;
+}
+
+/**
+ * @name   fiber_destory(fiber_t fiber)
+ * 
+ * @brief  Desaloca uma fiber finalizada que não foi esperada por fiber_join,
+ * descartando seu valor de retorno.
+ * 
+ * @param  fiber - identificador da fiber que deve ser desalocada.
+ * 
+ * @return 0 para sucesso; -1 se a fiber não existe ou ainda não terminou.
+*/
+int fiber_destroy(fiber_t fiber)
+{
+    stop_timer();
+
+    int i = 0;
+    Fiber *fiber_node = NULL;
+    for (fiber_node = fiber_list->head; fiber != fiber_node && ++i <= fiber_list->size; fiber_node = fiber_node->next);
+
+    if (i > fiber_list->size || fiber_node->status != STATE_FINISHED)
+    {
+        start_timer();
+        return -1;
+    }
+
+    fiber_list->zombies--;
+    pop(fiber_node);
+
+    start_timer();
+
+    return 0;
+}
+
+/**
+ * @name   fiber_detach(fiber_t fiber)
+ * 
+ * @brief  Faz a fiber ser desalocada assim que terminar, sem esperar fiber_join
+ * ou fiber_destroy. Se ela já terminou é desalocada agora.
+ * 
+ * @param  fiber - identificador da fiber.
+ * 
+ * @return 0 para sucesso; -1 se a fiber não existe.
+*/
+int fiber_detach(fiber_t fiber)
+{
+    stop_timer();
+
+    int i = 0;
+    Fiber *fiber_node = NULL;
+    for (fiber_node = fiber_list->head; fiber != fiber_node && ++i <= fiber_list->size; fiber_node = fiber_node->next);
+
+    if (i > fiber_list->size)
+    {
+        start_timer();
+        return -1;
+    }
+
+    if (fiber_node->status == STATE_FINISHED)
+    {
+        fiber_list->zombies--;
+        pop(fiber_node);
+    }
+    else
+    {
+        fiber_node->cold->detached = 1;
+    }
+
+    start_timer();
+
+    return 0;
+}
+
+/**
+ * @name   fiber_exit(void *retval;
+ * 
+ * @brief  Troca o status da fiber atual para STATE_FINISHED e  atribui o endereço.
+ * para o valor de  retorno. A fiber nunca mais será executada; é desalocada pelo
+ * scheduler se houver fibers em fiber_join, se foi desanexada ou se pertence a um
+ * grupo, e caso contrário permanece até uma fiber_join ou fiber_destroy. Antes
+ * disso executa as rotinas de limpeza ainda registradas, da última para a primeira.
+*/
+void fiber_exit(void *retval)
+{
+    // Guardado antes para que as rotinas de limpeza possam consultá-lo
+    fiber_list->running->cold->retval = retval;
+
+    while (fiber_list->running->cold->cleanup != NULL)
+        fiber_cleanup_pop(1);
+
+    stop_timer();
+
+    fiber_list->running->status = STATE_FINISHED;
+
+    TRACE(TRACE_EXIT, fiber_list->running);
+
+    if (swapcontext(&fiber_list->running->cold->context, &scheduler_ctx) == -1)
+        perror("swapcontext failed at fiber_exit.");
+}
+
+/**
+ * @name   fiber_yield()
+ * 
+ * @brief  Cede a CPU para a próxima fiber escolhida pela política. É um ponto de
+ * cancelamento.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_yield()
+{
+    fiber_testcancel();
+
+    stop_timer();
+
+    TRACE(TRACE_YIELD, fiber_list->running);
+
+    if (swapcontext(&fiber_list->running->cold->context, &scheduler_ctx) == -1)
+    {
+        perror("swapcontext failed at fiber_yield.");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @name   block_running()
+ * 
+ * @brief  Bloqueia a fiber atual, que já registrou o que está esperando. Deve ser
+ * chamada com o timer parado e retorna com ele ligado.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int block_running()
+{
+    fiber_list->running->status = STATE_BLOCKED;
+
+    TRACE(TRACE_BLOCK, fiber_list->running);
+
+    if (swapcontext(&fiber_list->running->cold->context, &scheduler_ctx) == -1)
+    {
+        perror("swapcontext failed at block_running.");
+        return -1;
+    }
+
+    // Acordada pela fiber_cancel() antes do evento esperado
+    fiber_testcancel();
+
+    return 0;
+}
+
+/**
+ * @name   fiber_sleep(unsigned long usec)
+ * 
+ * @brief  Suspende a fiber atual por usec microsegundos sem ocupar a CPU. É um
+ * ponto de cancelamento.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_sleep(unsigned long usec)
+{
+    if (usec == 0)
+        return fiber_yield();
+
+    fiber_testcancel();
+
+    stop_timer();
+
+    Fiber *self = fiber_list->running;
+    self->wake_at = trace_now_ns() + usec * 1000ULL;
+    if (timer_insert(self) == -1)
+    {
+        self->wake_at = 0;
+        start_timer();
+        return -1;
+    }
+
+    return block_running();
+}
+
+/**
+ * @name   fiber_wait_io(int fd, int events)
+ * 
+ * @brief  Suspende a fiber atual até o descritor ficar pronto, sem ocupar a CPU.
+ * Várias fibers podem esperar o mesmo descritor, inclusive por eventos diferentes.
+ * É um ponto de cancelamento.
+ * 
+ * @param  fd descritor esperado.
+ * @param  events eventos da epoll esperados (EPOLLIN, EPOLLOUT, ...).
+ * 
+ * @return eventos recebidos; -1 para falha.
+*/
+int fiber_wait_io(int fd, int events)
+{
+    fiber_testcancel();
+
+    stop_timer();
+
+    Fiber *self = fiber_list->running;
+
+    if (fd < 0)
+    {
+        start_timer();
+        return -1;
+    }
+
+    if (fd >= fd_waiters_size)
+    {
+        int size = fd_waiters_size ? fd_waiters_size : IDLE_MAX_EVENTS;
+        while (size <= fd)
+            size *= 2;
+
+        Fd_Waiters *table = realloc(fd_waiters, size * sizeof(Fd_Waiters));
+        if (table == NULL)
+        {
+            perror("realloc failed at fiber_wait_io.");
+            start_timer();
+            return -1;
+        }
+        memset(table + fd_waiters_size, 0, (size - fd_waiters_size) * sizeof(Fd_Waiters));
+        fd_waiters = table;
+        fd_waiters_size = size;
+    }
+
+    self->cold->io_wait = events;
+    self->cold->io_next = fd_waiters[fd].head;
+    fd_waiters[fd].head = self;
+    self->cold->waitFd = fd;
+    io_waiters++;
+
+    if (fd_update(fd) == -1)
+    {
+        fd_unlink(self);
+        start_timer();
+        return -1;
+    }
+
+    if (block_running() == -1)
+        return -1;
+
+    return self->cold->io_events;
+}
+
+/**
+ * @name   fiber_park()
+ * 
+ * @brief  Suspende a fiber atual até alguém chamar fiber_unpark() para ela. Caso
+ * a permissão já tenha sido dada, retorna na hora consumindo-a. É um ponto de
+ * cancelamento.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_park()
+{
+    fiber_testcancel();
+
+    stop_timer();
+
+    Fiber *self = fiber_list->running;
+
+    if (__atomic_exchange_n(&self->cold->permit, 0, __ATOMIC_SEQ_CST))
+    {
+        start_timer();
+        return 0;
+    }
+
+    self->cold->parked = 1;
+    parked_fibers++;
+
+    return block_running();
+}
+
+/**
+ * @name   fiber_unpark(fiber_t fiber)
+ * 
+ * @brief  Dá a permissão para a fiber continuar e a acorda caso esteja na
+ * fiber_park(). Pode ser chamada por outras threads do processo; a fiber deve
+ * estar viva.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_unpark(fiber_t fiber)
+{
+    Fiber *fiber_node = fiber;
+
+    if (fiber_node == NULL)
+        return -1;
+
+    __atomic_store_n(&fiber_node->cold->permit, 1, __ATOMIC_SEQ_CST);
+
+    // Já está na pilha de despertares remotos
+    if (__atomic_exchange_n(&fiber_node->cold->remote_queued, 1, __ATOMIC_SEQ_CST))
+        return 0;
+
+    Fiber *head = __atomic_load_n(&remote_head, __ATOMIC_RELAXED);
+    do
+        fiber_node->cold->remote_next = head;
+    while (!__atomic_compare_exchange_n(&remote_head, &head, fiber_node, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    // Acorda o escalonador caso esteja dormindo na epoll_wait
+    uint64_t one = 1;
+    if (write(idle_eventfd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+    {
+        perror("write failed at fiber_unpark.");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @name   cancel_unblock(Fiber *fiber)
+ * 
+ * @brief  Acorda uma fiber em espera que foi cancelada, desfazendo o registro da
+ * espera. O nodo na waitList da joinFiber fica sem id e é descartado pela
+ * release_fibers(); timers saem do heap em O(log n) e descritores só percorrem as
+ * fibers que esperam o mesmo descritor.
+ * 
+ * @param  fiber fiber bloqueada.
+*/
+void cancel_unblock(Fiber *fiber)
+{
+    if (fiber->cold->waitNode != NULL)
+    {
+        fiber->cold->waitNode->id = NULL;
+        fiber->cold->waitNode = NULL;
+    }
+
+    if (fiber->cold->waitGroup != NULL)
+    {
+        fiber->cold->waitGroup->waiter = NULL;
+        fiber->cold->waitGroup = NULL;
+    }
+
+    fiber->cold->waitFuture = NULL;
+
+    if (fiber->wake_at != 0)
+        timer_remove(fiber);
+
+    if (fiber->cold->waitFd != -1)
+    {
+        int fd = fiber->cold->waitFd;
+        fd_unlink(fiber);
+        fd_update(fd);
+    }
+
+    if (fiber->cold->parked)
+    {
+        fiber->cold->parked = 0;
+        parked_fibers--;
+    }
+
+    fiber->cold->joinFiber = NULL;
+
+    sched_wake(fiber);
+}
+
+/**
+ * @name   cancel_fiber(Fiber *fiber)
+ * 
+ * @brief  Marca o cancelamento da fiber e a acorda caso esteja em espera. Deve ser
+ * chamada com o timer parado.
+*/
+void cancel_fiber(Fiber *fiber)
+{
+    fiber->cold->cancel = 1;
+
+    if (fiber->status == STATE_BLOCKED)
+        cancel_unblock(fiber);
+}
+
+/**
+ * @name   fiber_cancel(fiber_t fiber)
+ * 
+ * @brief  Pede o cancelamento da fiber. O cancelamento acontece no próximo ponto
+ * de cancelamento (fiber_join, fiber_yield, fiber_sleep, fiber_wait_io, fiber_park,
+ * future_get, esperas de grupo e fiber_testcancel); caso a fiber
+ * esteja em espera ela é acordada para atendê-lo. A fiber cancelada executa suas
+ * rotinas de limpeza e termina com o valor de retorno FIBER_CANCELED.
+ * 
+ * @param  fiber identificador da fiber.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_cancel(fiber_t fiber)
+{
+    Fiber *fiber_node = fiber;
+
+    if (fiber_node == NULL || fiber_node->status == STATE_FINISHED)
+        return -1;
+
+    stop_timer();
+
+    cancel_fiber(fiber_node);
+
+    start_timer();
+
+    return 0;
+}
+
+/**
+ * @name   fiber_testcancel()
+ * 
+ * @brief  Ponto de cancelamento explícito. Caso o cancelamento da fiber atual
+ * tenha sido pedido, ela termina com FIBER_CANCELED e esta função não retorna.
+*/
+void fiber_testcancel()
+{
+    if (!fiber_list->running->cold->cancel)
+        return;
+
+    // Rotinas de limpeza que chamem fiber_join não devem cancelar de novo
+    fiber_list->running->cold->cancel = 0;
+
+    fiber_exit(FIBER_CANCELED);
+}
+
+/**
+ * @name   fiber_cleanup_push(void (*routine)(void *), void *arg)
+ * 
+ * @brief  Empilha uma rotina de limpeza para a fiber atual. As rotinas são
+ * executadas quando a fiber termina ou é cancelada, da última para a primeira.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_cleanup_push(void (*routine)(void *), void *arg)
+{
+    if (routine == NULL)
+        return -1;
+
+    Cleanup *node = malloc(sizeof(Cleanup));
+    if (node == NULL)
+    {
+        perror("malloc failed at fiber_cleanup_push.");
+        return -1;
+    }
+
+    node->routine = routine;
+    node->arg = arg;
+    node->next = fiber_list->running->cold->cleanup;
+    fiber_list->running->cold->cleanup = node;
+
+    return 0;
+}
+
+/**
+ * @name   fiber_cleanup_pop(int execute)
+ * 
+ * @brief  Desempilha a última rotina de limpeza da fiber atual.
+ * 
+ * @param  execute caso não seja zero a rotina é executada.
+ * 
+ * @return 0 para sucesso; -1 caso a pilha esteja vazia.
+*/
+int fiber_cleanup_pop(int execute)
+{
+    Cleanup *node = fiber_list->running->cold->cleanup;
+
+    if (node == NULL)
+        return -1;
+
+    fiber_list->running->cold->cleanup = node->next;
+
+    if (execute)
+        node->routine(node->arg);
+
+    free(node);
+
+    return 0;
+}
+
+/**
+ * @name   fiber_group_create(fiber_group_t *group)
+ * 
+ * @brief  Cria um grupo vazio de fibers.
+ * 
+ * @param  group identificador que será retornado por referência.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_group_create(fiber_group_t *group)
+{
+    if (group == NULL)
+        return -1;
+
+    Fiber_Group *new_group = calloc(1, sizeof(Fiber_Group));
+    if (new_group == NULL)
+    {
+        perror("malloc failed at fiber_group_create.");
+        return -1;
+    }
+
+    *group = new_group;
+
+    return 0;
+}
+
+/**
+ * @name   fiber_group_spawn(fiber_group_t group, fiber_t *fiber, void *(*start_routine)(void *), void *arg)
+ * 
+ * @brief  Cria uma fiber filha do grupo.
+ * 
+ * @param  group grupo da nova fiber.
+ * @param  fiber identificador que será retornado por referência; pode ser nulo.
+ * @param  start_routine rotina que será executada.
+ * @param  arg argumento que será passados para a rotina.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_group_spawn(fiber_group_t group, fiber_t *fiber, void *(*start_routine)(void *), void *arg)
+{
+    fiber_t child;
+
+    if (group == NULL || ((Fiber_Group *)group)->destroyed)
+        return -1;
+
+    // Reservado agora para que o escalonador não precise alocar quando a filha terminar
+    Group_Result *result = malloc(sizeof(Group_Result));
+    if (result == NULL)
+    {
+        perror("malloc failed at fiber_group_spawn.");
+        return -1;
+    }
+
+    if (create_fiber(fiber != NULL ? fiber : &child, start_routine, arg, group, result, 0) == -1)
+    {
+        free(result);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @name   group_wait(Fiber_Group *group, int wait_any)
+ * 
+ * @brief  Bloqueia a fiber atual até o grupo acordá-la. Deve ser chamada com o
+ * timer parado e retorna com ele ligado.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int group_wait(Fiber_Group *group, int wait_any)
+{
+    Fiber *self = fiber_list->running;
+
+    group->waiter = self;
+    group->wait_any = wait_any;
+    self->cold->waitGroup = group;
+    self->status = STATE_BLOCKED;
+
+    TRACE(TRACE_BLOCK, self);
+
+    if (swapcontext(&self->cold->context, &scheduler_ctx) == -1)
+    {
+        perror("swapcontext failed at group_wait.");
+        return -1;
+    }
+
+    // Acordada pela fiber_cancel() antes do grupo
+    fiber_testcancel();
+
+    return 0;
+}
+
+/**
+ * @name   fiber_group_join_all(fiber_group_t group)
+ * 
+ * @brief  Espera todas as filhas do grupo terminarem. A fiber atual é acordada uma
+ * única vez, no término da última filha. Os resultados continuam disponíveis
+ * para a fiber_group_wait_any(). É um ponto de cancelamento.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_group_join_all(fiber_group_t group)
+{
+    Fiber_Group *fiber_group = group;
+
+    if (fiber_group == NULL)
+        return -1;
+
+    stop_timer();
+
+    // Ponto de cancelamento
+    if (fiber_list->running->cold->cancel)
+    {
+        start_timer();
+        fiber_testcancel();
+    }
+
+    if (fiber_group->live == 0)
+    {
+        start_timer();
+        return 0;
+    }
+
+    if (fiber_group->waiter != NULL)
+    {
+        start_timer();
+        return -1;
+    }
+
+    return group_wait(fiber_group, 0);
+}
+
+/**
+ * @name   fiber_group_wait_any(fiber_group_t group, fiber_t *fiber, void **retval, int cancel_others)
+ * 
+ * @brief  Espera a próxima filha do grupo terminar e consome seu resultado. Caso
+ * alguma já tenha terminado retorna sem bloquear. É um ponto de cancelamento.
+ * 
+ * @param  fiber identificador da filha que terminou; pode ser nulo.
+ * @param  retval valor de retorno da filha; pode ser nulo.
+ * @param  cancel_others caso não seja zero, cancela as filhas ainda vivas.
+ * 
+ * @return 0 para sucesso; -1 para falha ou caso não haja mais filhas.
+*/
+int fiber_group_wait_any(fiber_group_t group, fiber_t *fiber, void **retval, int cancel_others)
+{
+    Fiber_Group *fiber_group = group;
+
+    if (fiber_group == NULL)
+        return -1;
+
+    stop_timer();
+
+    // Ponto de cancelamento
+    if (fiber_list->running->cold->cancel)
+    {
+        start_timer();
+        fiber_testcancel();
+    }
+
+    // Outra fiber pode consumir o resultado antes da que foi acordada executar
+    while (fiber_group->head == NULL)
+    {
+        if (fiber_group->live == 0 || fiber_group->waiter != NULL)
+        {
+            start_timer();
+            return -1;
+        }
+
+        if (group_wait(fiber_group, 1) == -1)
+            return -1;
+
+        stop_timer();
+    }
+
+    Group_Result *result = fiber_group->head;
+    fiber_group->head = result->next;
+    if (fiber_group->head == NULL)
+        fiber_group->tail = NULL;
+
+    if (fiber != NULL)
+        *fiber = result->fiber;
+    if (retval != NULL)
+        *retval = result->retval;
+
+    free(result);
+
+    // Cancela as filhas perdedoras
+    if (cancel_others)
+        for (Fiber *child = fiber_group->children; child != NULL; child = child->cold->group_next)
+            cancel_fiber(child);
+
+    start_timer();
+
+    return 0;
+}
+
+/**
+ * @name   fiber_group_destroy(fiber_group_t group)
+ * 
+ * @brief  Desaloca o grupo. Caso ainda haja filhas vivas, elas continuam
+ * executando e o grupo só é desalocado quando a última terminar.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_group_destroy(fiber_group_t group)
+{
+    Fiber_Group *fiber_group = group;
+
+    if (fiber_group == NULL || fiber_group->destroyed || fiber_group->waiter != NULL)
+        return -1;
+
+    stop_timer();
+
+    if (fiber_group->live == 0)
+        group_free(fiber_group);
+    else
+        fiber_group->destroyed = 1;
+
+    start_timer();
+
+    return 0;
+}
+
+// Rotina das fibers das futures, definida abaixo
+void *future_start(void *arg);
+
+/**
+ * @name   future_launch(Future *future)
+ * 
+ * @brief  Cria a fiber que executa a rotina da future.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int future_launch(Future *future)
+{
+    fiber_t fiber;
+
+    return create_fiber(&fiber, future_start, future, NULL, NULL, 1);
+}
+
+/**
+ * @name   future_complete(Future *future, void *value)
+ * 
+ * @brief  Guarda o valor da future, acorda as fibers na future_get() e inicia as
+ * continuações com o valor.
+*/
+void future_complete(Future *future, void *value)
+{
+    stop_timer();
+
+    future->ready = 1;
+    future->value = value;
+
+    while (future->waitList != NULL)
+    {
+        Waiting *waitingNode = future->waitList;
+        Fiber *waitingFiber = waitingNode->id;
+
+        // O id é nulo caso a fiber tenha sido cancelada enquanto esperava
+        if (waitingFiber != NULL && waitingFiber->status == STATE_BLOCKED)
+        {
+            waitingFiber->cold->waitNode = NULL;
+            waitingFiber->cold->waitFuture = NULL;
+            sched_wake(waitingFiber);
+        }
+
+        future->waitList = waitingNode->next;
+        free(waitingNode);
+    }
+
+    start_timer();
+
+    while (future->then != NULL)
+    {
+        Future *next = future->then;
+        future->then = next->then_next;
+
+        next->arg = value;
+        if (future_launch(next) == -1)
+            future_complete(next, FIBER_CANCELED);
+    }
+
+    if (future->destroyed)
+        free(future);
+}
+
+/**
+ * @name   future_abandon(void *arg)
+ * 
+ * @brief  Rotina de limpeza da fiber de uma future: caso a fiber termine sem a
+ * rotina retornar (fiber_exit ou cancelamento), a future fica pronta com o valor
+ * de retorno da fiber, para que ninguém espere por ela para sempre.
+*/
+void future_abandon(void *arg)
+{
+    future_complete(arg, fiber_list->running->cold->retval);
+}
+
+/**
+ * @name   future_start(void *arg)
+ * 
+ * @brief  Rotina das fibers das futures. Executa a rotina da future e guarda o
+ * valor retornado.
+*/
+void *future_start(void *arg)
+{
+    Future *future = arg;
+
+    fiber_cleanup_push(future_abandon, future);
+
+    void *value = future->start_routine(future->arg);
+
+    fiber_cleanup_pop(0);
+    future_complete(future, value);
+
+    return value;
+}
+
+/**
+ * @name   fiber_async(fiber_future_t *future, void *(*start_routine)(void *), void *arg)
+ * 
+ * @brief  Executa a rotina em uma nova fiber e retorna uma future para o seu valor
+ * de retorno.
+ * 
+ * @param  future identificador que será retornado por referência.
+ * @param  start_routine rotina que será executada.
+ * @param  arg argumento que será passados para a rotina.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_async(fiber_future_t *future, void *(*start_routine)(void *), void *arg)
+{
+    if (future == NULL || start_routine == NULL)
+        return -1;
+
+    Future *new_future = calloc(1, sizeof(Future));
+    if (new_future == NULL)
+    {
+        perror("malloc failed at fiber_async.");
+        return -1;
+    }
+
+    new_future->start_routine = start_routine;
+    new_future->arg = arg;
+
+    if (future_launch(new_future) == -1)
+    {
+        free(new_future);
+        return -1;
+    }
+
+    *future = new_future;
+
+    return 0;
+}
+
+/**
+ * @name   future_then(fiber_future_t future, fiber_future_t *next, void *(*start_routine)(void *))
+ * 
+ * @brief  Registra uma continuação: quando a future ficar pronta, start_routine é
+ * executada em uma nova fiber recebendo o valor dela como argumento.
+ * 
+ * @param  future future anterior.
+ * @param  next future da continuação, retornada por referência.
+ * @param  start_routine rotina da continuação.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int future_then(fiber_future_t future, fiber_future_t *next, void *(*start_routine)(void *))
+{
+    Future *prev = future;
+
+    if (prev == NULL || prev->destroyed || next == NULL || start_routine == NULL)
+        return -1;
+
+    Future *new_future = calloc(1, sizeof(Future));
+    if (new_future == NULL)
+    {
+        perror("malloc failed at future_then.");
+        return -1;
+    }
+
+    new_future->start_routine = start_routine;
+
+    stop_timer();
+
+    if (prev->ready)
+    {
+        start_timer();
+
+        new_future->arg = prev->value;
+        if (future_launch(new_future) == -1)
+        {
+            free(new_future);
+            return -1;
+        }
+    }
+    else
+    {
+        new_future->then_next = prev->then;
+        prev->then = new_future;
+
+        start_timer();
+    }
+
+    *next = new_future;
+
+    return 0;
+}
+
+/**
+ * @name   future_get(fiber_future_t future, void **value)
+ * 
+ * @brief  Espera a future ficar pronta e obtém seu valor. É um ponto de
+ * cancelamento.
+ * 
+ * @param  value endereço para onde será colocado o valor. Caso seja nulo será
+ * ignorado.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int future_get(fiber_future_t future, void **value)
+{
+    Future *fiber_future = future;
+
+    if (fiber_future == NULL || fiber_future->destroyed)
+        return -1;
+
+    stop_timer();
+
+    // Ponto de cancelamento
+    if (fiber_list->running->cold->cancel)
+    {
+        start_timer();
+        fiber_testcancel();
+    }
+
+    if (!fiber_future->ready)
+    {
+        Waiting *waitingNode = malloc(sizeof(Waiting));
+        if (waitingNode == NULL)
+        {
+            perror("malloc failed at future_get.");
+            start_timer();
+            return -1;
+        }
+
+        waitingNode->id = fiber_list->running;
+        waitingNode->next = fiber_future->waitList;
+        fiber_future->waitList = waitingNode;
+
+        fiber_list->running->cold->waitNode = waitingNode;
+        fiber_list->running->cold->waitFuture = fiber_future;
+
+        if (block_running() == -1)
+            return -1;
+    }
+    else
+    {
+        start_timer();
+    }
+
+    if (value != NULL)
+        *value = fiber_future->value;
+
+    return 0;
+}
+
+/**
+ * @name   future_ready(fiber_future_t future)
+ * 
+ * @return 1 caso o valor da future esteja pronto; 0 caso contrário.
+*/
+int future_ready(fiber_future_t future)
+{
+    return future != NULL && ((Future *)future)->ready;
+}
+
+/**
+ * @name   future_destroy(fiber_future_t future)
+ * 
+ * @brief  Desaloca a future. Caso o valor ainda não esteja pronto, a desalocação
+ * acontece quando a rotina terminar.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int future_destroy(fiber_future_t future)
+{
+    Future *fiber_future = future;
+
+    if (fiber_future == NULL || fiber_future->destroyed || fiber_future->waitList != NULL)
+        return -1;
+
+    stop_timer();
+
+    if (fiber_future->ready)
+        free(fiber_future);
+    else
+        fiber_future->destroyed = 1;
+
+    start_timer();
+
+    return 0;
+}
+
+/**
+ * @struct Parallel_Range
+ * 
+ * @brief  Intervalo de um fiber_parallel_for() atribuído a uma fiber.
+*/
+typedef struct Parallel_Range
+{
+    long begin;                           // início do intervalo
+    long end;                             // fim do intervalo, exclusivo
+    long grain;                           // tamanho máximo sem dividir
+    void (*routine)(long, long, void *);  // rotina do laço
+    void *arg;                            // argumento da rotina
+} Parallel_Range;
+
+// Rotina das fibers do fiber_parallel_for, definida abaixo
+void *parallel_start(void *arg);
+
+/**
+ * @name   parallel_abandon(void *arg)
+ * 
+ * @brief  Rotina de limpeza da parallel_split(): caso a fiber seja cancelada depois
+ * de criar o grupo, ele é desalocado quando as metades que criou terminarem.
+*/
+void parallel_abandon(void *arg)
+{
+    fiber_group_destroy(arg);
+}
+
+/**
+ * @name   parallel_split(Parallel_Range *range)
+ * 
+ * @brief  Divide o intervalo ao meio enquanto for maior que o grain, entregando a
+ * metade de cima para uma nova fiber, que continua dividindo a sua parte. O que
+ * sobra é executado pela fiber atual, que depois espera as metades que criou.
+*/
+void parallel_split(Parallel_Range *range)
+{
+    fiber_group_t group = NULL;
+    long begin = range->begin;
+    long end = range->end;
+
+    while (end - begin > range->grain)
+    {
+        long middle = begin + (end - begin) / 2;
+
+        Parallel_Range *half = malloc(sizeof(Parallel_Range));
+        if (half == NULL)
+            break;
+
+        if (group == NULL)
+        {
+            if (fiber_group_create(&group) == -1)
+            {
+                free(half);
+                break;
+            }
+
+            // A rotina e a fiber_group_join_all podem ser pontos de cancelamento
+            fiber_cleanup_push(parallel_abandon, group);
+        }
+
+        *half = *range;
+        half->begin = middle;
+        half->end = end;
+
+        if (fiber_group_spawn(group, NULL, parallel_start, half) == -1)
+        {
+            free(half);
+            break;
+        }
+
+        end = middle;
+    }
+
+    range->routine(begin, end, range->arg);
+
+    if (group != NULL)
+    {
+        fiber_group_join_all(group);
+        fiber_cleanup_pop(0);
+
+        fiber_group_destroy(group);
+    }
+}
+
+/**
+ * @name   parallel_start(void *arg)
+ * 
+ * @brief  Rotina das fibers criadas pela parallel_split().
+*/
+void *parallel_start(void *arg)
+{
+    parallel_split(arg);
+    free(arg);
+
+    return NULL;
+}
+
+/**
+ * @name   fiber_routine(void *(*start_routine)(void *), void *arg)
+ * 
+ * @brief  Identifica a rotina do usuário de uma nova fiber. As fibers das futures
+ * e do fiber_parallel_for executam rotinas internas; o profiling de pilha e a
+ * fiber_dump usam a rotina passada pelo usuário, lida do argumento enquanto ele
+ * ainda é válido.
+ * 
+ * @return rotina do usuário.
+*/
+void *(*fiber_routine(void *(*start_routine)(void *), void *arg))(void *)
+{
+    if (start_routine == future_start)
+        return ((Future *)arg)->start_routine;
+
+    if (start_routine == parallel_start)
+        return (void *(*)(void *))(void (*)(void))((Parallel_Range *)arg)->routine;
+
+    return start_routine;
+}
+
+/**
+ * @name   fiber_parallel_for(long begin, long end, long grain, void (*routine)(long, long, void *), void *arg)
+ * 
+ * @brief  Executa routine sobre o intervalo [begin, end) dividido em pedaços de
+ * até grain elementos, cada um em uma fiber. Retorna quando todos terminarem.
+ * 
+ * @param  grain tamanho máximo de cada pedaço. Caso não seja positivo é escolhido
+ * para gerar PARALLEL_FOR_CHUNKS pedaços por processador.
+ * @param  routine rotina chamada com o início e o fim de cada pedaço.
+ * @param  arg argumento passado para a rotina.
  * 
  * @return 0 para sucesso; -1 para falha.
 */
-int fiber_destroy(fiber_t fiber)
+int fiber_parallel_for(long begin, long end, long grain, void (*routine)(long, long, void *), void *arg)
 {
-    int i = 0;
-    Fiber *fiber_node = NULL;
-    for (fiber_node = fiber_list->head; fiber != fiber_node && ++i <= fiber_list->size; fiber_node = fiber_node->next);
+    if (routine == NULL || end < begin)
+        return -1;
 
-    if (i > fiber_list->size)
+    if (grain <= 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        grain = (end - begin) / ((cpus > 0 ? cpus : 1) * PARALLEL_FOR_CHUNKS);
+        if (grain < 1)
+            grain = 1;
+    }
+
+    Parallel_Range range = {begin, end, grain, routine, arg};
+    parallel_split(&range);
+
+    return 0;
+}
+
+/**
+ * @name   fiber_sched_register(const fiber_sched_policy_t *policy)
+ * 
+ * @brief  Registra uma política de escalonamento, que poderá ser escolhida pelo
+ * nome na fiber_sched_set_policy(). A estrutura não é copiada e deve existir
+ * enquanto a biblioteca for usada.
+ * 
+ * @param  policy política com pelo menos enqueue e pick_next definidos.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_sched_register(const fiber_sched_policy_t *policy)
+{
+    if (policy == NULL || policy->name == NULL || policy->enqueue == NULL || policy->pick_next == NULL)
         return -1;
-    
-    if (pop(fiber_node) == NULL)
+
+    if (sched_policies_size == SCHED_MAX_POLICIES)
         return -1;
-    
+
+    for (int i = 0; i < sched_policies_size; i++)
+        if (strcmp(sched_policies[i]->name, policy->name) == 0)
+            return -1;
+
+    sched_policies[sched_policies_size++] = policy;
+
     return 0;
 }
 
 /**
- * @name   fiber_exit(void *retval;
+ * @name   fiber_sched_set_policy(const char *name)
  * 
- * @brief  Troca o status da fiber atual para STATE_FINISHED e  atribui o endereço.
- * para o valor de  retorno. Quando identificada pelo  scheduler  será desalocada e
- * nunca mais será executada.
+ * @brief  Escolhe a política de escalonamento. As nativas são "fifo", "rr"
+ * (padrão), "priority" e "edf". Só pode ser chamada enquanto não houver outras
+ * fibers além da principal, pois a fila de prontos pertence à política.
+ * 
+ * @param  name nome da política.
+ * 
+ * @return 0 para sucesso; -1 para falha.
 */
-void fiber_exit(void *retval)
+int fiber_sched_set_policy(const char *name)
 {
-    fiber_list->running->retval = retval;
-    fiber_list->running->status = STATE_FINISHED;
-    preempt();
+    if (name == NULL || fiber_list->size != 1)
+        return -1;
+
+    for (int i = 0; i < sched_policies_size; i++)
+    {
+        if (strcmp(sched_policies[i]->name, name) == 0)
+        {
+            sched_policy = sched_policies[i];
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @name   fiber_sched_policy_name()
+ * 
+ * @return nome da política de escalonamento em uso.
+*/
+const char *fiber_sched_policy_name()
+{
+    return sched_policy->name;
+}
+
+/**
+ * @name   fiber_set_priority(fiber_t fiber, int priority)
+ * 
+ * @brief  Define a prioridade da fiber, de 0 a FIBER_PRIORITY_LEVELS - 1; quanto
+ * maior, antes ela é escolhida pela política "priority". Vale a partir da próxima
+ * vez que a fiber entrar na fila de prontos.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_set_priority(fiber_t fiber, int priority)
+{
+    if (fiber == NULL || priority < 0 || priority >= FIBER_PRIORITY_LEVELS)
+        return -1;
+
+    ((Fiber *)fiber)->priority = priority;
+
+    return 0;
+}
+
+/**
+ * @name   fiber_get_priority(fiber_t fiber)
+ * 
+ * @return prioridade da fiber; -1 para falha.
+*/
+int fiber_get_priority(fiber_t fiber)
+{
+    if (fiber == NULL)
+        return -1;
+
+    return ((Fiber *)fiber)->priority;
+}
+
+/**
+ * @name   fiber_set_deadline(fiber_t fiber, unsigned long long deadline)
+ * 
+ * @brief  Define o prazo absoluto da fiber, em nanosegundos do CLOCK_MONOTONIC,
+ * usado pela política "edf". Zero significa sem prazo. Vale a partir da próxima
+ * vez que a fiber entrar na fila de prontos.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_set_deadline(fiber_t fiber, unsigned long long deadline)
+{
+    if (fiber == NULL)
+        return -1;
+
+    ((Fiber *)fiber)->deadline = deadline;
+
+    return 0;
+}
+
+/**
+ * @name   fiber_get_deadline(fiber_t fiber)
+ * 
+ * @return prazo absoluto da fiber; 0 caso não tenha.
+*/
+unsigned long long fiber_get_deadline(fiber_t fiber)
+{
+    if (fiber == NULL)
+        return 0;
+
+    return ((Fiber *)fiber)->deadline;
+}
+
+/**
+ * @name   fiber_set_sched_data(fiber_t fiber, void *data)
+ * 
+ * @brief  Associa um dado à fiber para uso de políticas registradas pelo usuário.
+*/
+void fiber_set_sched_data(fiber_t fiber, void *data)
+{
+    if (fiber != NULL)
+        ((Fiber *)fiber)->cold->sched_data = data;
+}
+
+/**
+ * @name   fiber_get_sched_data(fiber_t fiber)
+ * 
+ * @return dado associado à fiber pela fiber_set_sched_data().
+*/
+void *fiber_get_sched_data(fiber_t fiber)
+{
+    if (fiber == NULL)
+        return NULL;
+
+    return ((Fiber *)fiber)->cold->sched_data;
+}
+
+/**
+ * @name   fiber_stack_profile_start()
+ * 
+ * @brief  Liga o profiling de pilha: as fibers criadas a partir de agora têm a
+ * pilha pintada e, quando são desalocadas, seu uso máximo é acumulado nas
+ * estatísticas da sua rotina.
+*/
+void fiber_stack_profile_start()
+{
+    stack_profile_enabled = 1;
+}
+
+/**
+ * @name   fiber_stack_profile_stop()
+ * 
+ * @brief  Desliga o profiling de pilha para as próximas fibers. As fibers já
+ * pintadas ainda são medidas.
+*/
+void fiber_stack_profile_stop()
+{
+    stack_profile_enabled = 0;
+}
+
+/**
+ * @name   fiber_stack_stats(void *(*start_routine)(void *), fiber_stack_stats_t *stats)
+ * 
+ * @brief  Consulta o uso de pilha acumulado das fibers de uma rotina.
+ * 
+ * @param  start_routine rotina consultada.
+ * @param  stats estrutura onde as estatísticas serão copiadas.
+ * 
+ * @return 0 para sucesso; -1 caso nenhuma fiber da rotina tenha sido medida.
+*/
+int fiber_stack_stats(void *(*start_routine)(void *), fiber_stack_stats_t *stats)
+{
+    if (stats == NULL)
+        return -1;
+
+    for (Stack_Profile *profile = stack_profiles; profile != NULL; profile = profile->next)
+    {
+        if (profile->start_routine == start_routine)
+        {
+            *stats = profile->stats;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @name   fiber_stack_report(FILE *out)
+ * 
+ * @brief  Escreve o uso de pilha de cada rotina medida: quantidade de fibers,
+ * média, máximo e o histograma por faixa de tamanho.
+ * 
+ * @param  out arquivo de saída.
+*/
+void fiber_stack_report(FILE *out)
+{
+    for (Stack_Profile *profile = stack_profiles; profile != NULL; profile = profile->next)
+    {
+        fiber_stack_stats_t *stats = &profile->stats;
+
+        fprintf(out, "routine %p: fibers %lu, avg %zu, max %zu of %d bytes\n", (void *)profile->start_routine,
+                stats->count, stats->total / stats->count, stats->max, FIBER_STACK_SIZE);
+
+        for (int i = 0; i < FIBER_STACK_BUCKETS; i++)
+            if (stats->histogram[i] != 0)
+                fprintf(out, "  <= %6d: %lu\n", FIBER_STACK_BUCKET_MIN << i, stats->histogram[i]);
+    }
+}
+
+/**
+ * @name   stack_report_at_exit()
+ * 
+ * @brief  Registrada com atexit() quando FIBER_STACK_PROFILE está definida.
+*/
+void stack_report_at_exit()
+{
+    fiber_stack_report(stderr);
+}
+
+/**
+ * @name   fiber_dump(FILE *out)
+ * 
+ * @brief  Escreve um retrato de todas as fibers vivas: id, estado, o que cada uma
+ * está esperando (fiber, grupo, future, descritor, timer ou park), tempo em
+ * execução e backtrace a partir do contexto salvo. O escalonamento fica parado
+ * só durante a escrita.
+ * 
+ * @param  out arquivo de saída.
+*/
+void fiber_dump(FILE *out)
+{
+    if (out == NULL)
+        return;
+
+    stop_timer();
+
+    dump_fibers(out, fiber_list->running);
+
+    start_timer();
+}
+
+/**
+ * @name   dump_signal(int signo)
+ * 
+ * @brief  Handler do sinal instalado pela fiber_dump_on_signal(). Só registra o
+ * pedido; o retrato é escrito na próxima troca de fiber ou no próximo fim de time
+ * slice, quando os contextos de todas as fibers estão salvos.
+*/
+void dump_signal(int signo)
+{
+    dump_requested = 1;
+}
+
+/**
+ * @name   fiber_dump_on_signal(int signo)
+ * 
+ * @brief  Instala um handler para o sinal que faz o escalonador escrever a
+ * fiber_dump() no stderr na próxima troca de fiber. Também acorda o escalonador
+ * caso ele esteja dormindo na epoll_wait.
+ * 
+ * @param  signo sinal, por exemplo SIGUSR1 ou SIGQUIT.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_dump_on_signal(int signo)
+{
+    struct sigaction new_s;
+    memset(&new_s, 0, sizeof(new_s));
+    new_s.sa_handler = &dump_signal;
+    sigemptyset(&new_s.sa_mask);
+
+    if (sigaction(signo, &new_s, NULL) == -1)
+    {
+        perror("sigaction failed at fiber_dump_on_signal.");
+        return -1;
+    }
+
+    return 0;
 }
 
 /**
@@ -651,8 +3424,9 @@ void init_preempt()
     */
 
     struct sigaction new_s;
-    new_s.sa_handler = &preempt;
-    new_s.sa_flags = 0;
+    new_s.sa_sigaction = &preempt;
+    new_s.sa_flags = SA_SIGINFO;
+    sigemptyset(&new_s.sa_mask);
 
     if (sigaction(SIGVTALRM, &new_s, NULL) == -1)
     {
@@ -661,6 +3435,155 @@ void init_preempt()
     }
 }
 
+/**
+ * @name   fiber_trace_dump(FILE *out)
+ * 
+ * @brief  Escreve os eventos do buffer de tracing da thread no formato JSON do
+ * Chrome trace, que pode ser aberto no chrome://tracing ou no Perfetto UI. Cada
+ * fiber aparece como uma thread; os intervalos em execução aparecem como fatias.
+ * 
+ * @param  out arquivo de saída.
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_trace_dump(FILE *out)
+{
+    static const char *names[] = {"create", "run", "preempt", "block", "wake", "exit", "yield", "stop"};
+
+    if (out == NULL || trace_buffer.events == NULL)
+        return -1;
+
+    // Converte os ticks do TSC para microsegundos usando o intervalo desde o início
+    unsigned long long tsc_elapsed = trace_tsc() - trace_buffer.tsc_start;
+    unsigned long long ns_elapsed = trace_now_ns() - trace_buffer.ns_start;
+    double us_per_tick = tsc_elapsed ? (double)ns_elapsed / tsc_elapsed / 1000.0 : 0.001;
+
+    unsigned long head = __atomic_load_n(&trace_buffer.head, __ATOMIC_ACQUIRE);
+    unsigned long first = head > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : 0;
+    int pid = getpid();
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    for (unsigned long i = first; i < head; i++)
+    {
+        Trace_Event *event = &trace_buffer.events[i & (TRACE_BUFFER_SIZE - 1)];
+        double ts = (event->tsc - trace_buffer.tsc_start) * us_per_tick;
+        const char *sep = i == first ? "\n" : ",\n";
+
+        switch (event->type)
+        {
+        case TRACE_RUN:
+            fprintf(out, "%s{\"name\":\"run\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu}",
+                    sep, ts, pid, event->fiber);
+            break;
+        case TRACE_PREEMPT:
+        case TRACE_YIELD:
+        case TRACE_STOP:
+        case TRACE_BLOCK:
+        case TRACE_EXIT:
+            // Encerra a fatia "run" aberta e marca o motivo da saída da CPU
+            fprintf(out, "%s{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu}", sep, ts, pid, event->fiber);
+            sep = ",\n";
+            // fall through
+        default:
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%lu}",
+                    sep, names[event->type], ts, pid, event->fiber);
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+
+    return ferror(out) ? -1 : 0;
+}
+
+/**
+ * @name   trace_dump_at_exit()
+ * 
+ * @brief  Registrada com atexit() pela fiber_trace_start(). Salva o trace no
+ * arquivo informado.
+*/
+void trace_dump_at_exit()
+{
+    if (trace_buffer.path == NULL)
+        return;
+
+    FILE *out = fopen(trace_buffer.path, "w");
+    if (out == NULL)
+    {
+        perror("fopen failed at trace_dump_at_exit.");
+        return;
+    }
+
+    fiber_trace_dump(out);
+    fclose(out);
+}
+
+/**
+ * @name   fiber_trace_start(const char *path)
+ * 
+ * @brief  Liga o tracing dos eventos de criação, execução, preempção, yield, bloqueio,
+ * despertar e término das fibers.
+ * 
+ * @param  path arquivo onde o trace será salvo quando o processo terminar. Caso
+ * seja nulo o trace só é gerado pela fiber_trace_dump().
+ * 
+ * @return 0 para sucesso; -1 para falha.
+*/
+int fiber_trace_start(const char *path)
+{
+    if (trace_buffer.events == NULL)
+    {
+        trace_buffer.events = calloc(TRACE_BUFFER_SIZE, sizeof(Trace_Event));
+        if (trace_buffer.events == NULL)
+        {
+            perror("malloc failed at fiber_trace_start.");
+            return -1;
+        }
+
+        trace_buffer.head = 0;
+        trace_buffer.tsc_start = trace_tsc();
+        trace_buffer.ns_start = trace_now_ns();
+    }
+
+    if (path != NULL)
+    {
+        // Cópia própria: o trace é salvo no exit, depois que o chamador já liberou a sua
+        char *path_copy = strdup(path);
+        if (path_copy == NULL)
+        {
+            perror("strdup failed at fiber_trace_start.");
+            return -1;
+        }
+
+        if (trace_buffer.path == NULL)
+            atexit(trace_dump_at_exit);
+        else
+            free(trace_buffer.path);
+        trace_buffer.path = path_copy;
+    }
+
+    // Abre a fatia "run" da fiber que já estava executando
+    if (!trace_enabled)
+    {
+        trace_enabled = 1;
+        TRACE(TRACE_RUN, fiber_list->running);
+    }
+
+    return 0;
+}
+
+/**
+ * @name   fiber_trace_stop()
+ * 
+ * @brief  Desliga o tracing. Os eventos já registrados continuam no buffer, com a
+ * fatia da fiber em execução encerrada.
+*/
+void fiber_trace_stop()
+{
+    TRACE(TRACE_STOP, fiber_list->running);
+    trace_enabled = 0;
+}
+
 /**
  * @brief É executada quando a biblioteca é carregada.
 */
@@ -668,4 +3591,23 @@ __attribute__((constructor)) void init()
 {
     init_fiber_list();
     init_preempt();
+    init_idle();
+
+    // FIBER_STACK_PROFILE=1 liga o profiling de pilha e imprime o resultado no exit
+    const char *stack_profile = getenv("FIBER_STACK_PROFILE");
+    if (stack_profile != NULL && *stack_profile != '\0' && *stack_profile != '0')
+    {
+        fiber_stack_profile_start();
+        atexit(stack_report_at_exit);
+    }
+
+    // FIBER_SCHED=<política> escolhe a política de escalonamento
+    const char *sched_name = getenv("FIBER_SCHED");
+    if (sched_name != NULL && *sched_name != '\0' && fiber_sched_set_policy(sched_name) == -1)
+        fprintf(stderr, "unknown scheduling policy: %s\n", sched_name);
+
+    // FIBER_TRACE=<arquivo> liga o tracing desde o início do processo
+    const char *trace_path = getenv("FIBER_TRACE");
+    if (trace_path != NULL && *trace_path != '\0')
+        fiber_trace_start(trace_path);
 }
\ No newline at end of file
@@ -1,11 +1,125 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <stdio.h>
+
 typedef void * fiber_t;
 
+typedef void * fiber_group_t;
+
+typedef void * fiber_future_t;
+
+#define FIBER_PRIORITY_LEVELS 32
+
+#define FIBER_CANCELED ((void *)-1)
+
+#define FIBER_STACK_BUCKETS 8
+#define FIBER_STACK_BUCKET_MIN 512
+
+typedef struct fiber_sched_policy
+{
+    const char *name;
+    void (*enqueue)(fiber_t fiber);      // fiber ficou pronta
+    fiber_t (*pick_next)(void);          // retira a próxima fiber a executar; NULL se não houver
+    void (*on_block)(fiber_t fiber);     // opcional; fiber entrou em espera
+    void (*on_wake)(fiber_t fiber);      // opcional; chamado antes do enqueue da fiber acordada
+    int (*on_tick)(fiber_t fiber);       // opcional; fim do time slice, retorna 0 para não preemptar
+} fiber_sched_policy_t;
+
+typedef struct fiber_stack_stats
+{
+    unsigned long count;                          // fibers medidas
+    size_t total;                                 // soma dos usos; média = total / count
+    size_t max;                                   // maior uso em bytes
+    unsigned long histogram[FIBER_STACK_BUCKETS]; // histogram[i]: uso <= FIBER_STACK_BUCKET_MIN << i
+} fiber_stack_stats_t;
+
 int fiber_create(fiber_t *fiber, void *(*start_routine) (void *), void *arg);
 
 int fiber_join(fiber_t fiber, void **retval);
 
 int fiber_destroy(fiber_t fiber);
 
+int fiber_detach(fiber_t fiber);
+
 fiber_t fiber_self();
 
 void fiber_exit(void *retval);
+
+int fiber_yield();
+
+int fiber_sleep(unsigned long usec);
+
+int fiber_wait_io(int fd, int events);
+
+int fiber_park();
+
+int fiber_unpark(fiber_t fiber);
+
+int fiber_cancel(fiber_t fiber);
+
+void fiber_testcancel();
+
+int fiber_cleanup_push(void (*routine)(void *), void *arg);
+
+int fiber_cleanup_pop(int execute);
+
+int fiber_group_create(fiber_group_t *group);
+
+int fiber_group_spawn(fiber_group_t group, fiber_t *fiber, void *(*start_routine) (void *), void *arg);
+
+int fiber_group_join_all(fiber_group_t group);
+
+int fiber_group_wait_any(fiber_group_t group, fiber_t *fiber, void **retval, int cancel_others);
+
+int fiber_group_destroy(fiber_group_t group);
+
+int fiber_async(fiber_future_t *future, void *(*start_routine) (void *), void *arg);
+
+int future_then(fiber_future_t future, fiber_future_t *next, void *(*start_routine) (void *));
+
+int future_get(fiber_future_t future, void **value);
+
+int future_ready(fiber_future_t future);
+
+int future_destroy(fiber_future_t future);
+
+int fiber_parallel_for(long begin, long end, long grain, void (*routine) (long, long, void *), void *arg);
+
+int fiber_trace_start(const char *path);
+
+void fiber_trace_stop();
+
+int fiber_trace_dump(FILE *out);
+
+void fiber_dump(FILE *out);
+
+int fiber_dump_on_signal(int signo);
+
+int fiber_sched_register(const fiber_sched_policy_t *policy);
+
+int fiber_sched_set_policy(const char *name);
+
+const char *fiber_sched_policy_name();
+
+int fiber_set_priority(fiber_t fiber, int priority);
+
+int fiber_get_priority(fiber_t fiber);
+
+int fiber_set_deadline(fiber_t fiber, unsigned long long deadline);
+
+unsigned long long fiber_get_deadline(fiber_t fiber);
+
+void fiber_set_sched_data(fiber_t fiber, void *data);
+
+void *fiber_get_sched_data(fiber_t fiber);
+
+void fiber_stack_profile_start();
+
+void fiber_stack_profile_stop();
+
+int fiber_stack_stats(void *(*start_routine)(void *), fiber_stack_stats_t *stats);
+
+void fiber_stack_report(FILE *out);
+
+#endif